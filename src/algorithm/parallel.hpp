@@ -0,0 +1,145 @@
+#pragma once
+
+#include "pool/fiber_pool.hpp"
+#include "synchronization/counter.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+namespace np
+{
+    // All algorithms must be called from a fiber, the caller works on its own share and then waits for the rest
+    //  Ranges are given by integers or random access iterators, and the function receives each of them
+
+    namespace detail
+    {
+        // Roughly this many chunks per worker, so that uneven chunks still balance out
+        inline constexpr std::size_t parallel_chunks_per_thread = 8;
+
+        // A grain of 0 picks one adaptively, explicit grains are only raised so chunks never outnumber fibers,
+        //  anything above that would sit in the pool's task queue
+        inline std::size_t parallel_chunk_count(const fiber_pool_base& pool, std::size_t size, std::size_t grain) noexcept
+        {
+            const std::size_t maximum_chunks = std::max<std::size_t>(1, pool.target_number_of_fibers() / 2);
+            if (grain == 0)
+            {
+                grain = std::max<std::size_t>(1, size / (std::size_t(pool.number_of_threads()) * parallel_chunks_per_thread));
+            }
+
+            const std::size_t chunks = (size + grain - 1) / grain;
+            return std::clamp<std::size_t>(chunks, 1, maximum_chunks);
+        }
+
+        // Halves [first, last) chunks, pushing the upper half, until a single chunk is left to run inline
+        //  Pushed halves keep splitting on their own, so the caller only pays for log(chunks) pushes
+        template <typename P, typename B>
+        struct parallel_chunks
+        {
+            P& pool;
+            B& body;
+            np::counter counter;
+
+            void run(std::size_t first, std::size_t last) noexcept
+            {
+                while (last - first > 1)
+                {
+                    const std::size_t middle = first + (last - first) / 2;
+                    pool.push([this, middle, last] { run(middle, last); }, counter);
+                    last = middle;
+                }
+
+                body(first);
+            }
+        };
+
+        template <typename P, typename B>
+        void run_parallel_chunks(P& pool, std::size_t chunks, B&& body) noexcept
+        {
+            parallel_chunks<P, std::remove_reference_t<B>> state{ pool, body, np::counter{} };
+            state.run(0, chunks);
+            state.counter.wait();
+        }
+
+        // Bounds of chunk out of chunks over size elements, the first size % chunks chunks get one extra element
+        inline std::size_t parallel_chunk_begin(std::size_t chunk, std::size_t chunks, std::size_t size) noexcept
+        {
+            return chunk * (size / chunks) + std::min(chunk, size % chunks);
+        }
+    }
+
+    template <typename P, typename I, typename F>
+    void parallel_for(P& pool, I begin, I end, std::size_t grain, F&& function) noexcept
+    {
+        const std::size_t size = static_cast<std::size_t>(end - begin);
+        if (size == 0)
+        {
+            return;
+        }
+
+        const std::size_t chunks = detail::parallel_chunk_count(pool, size, grain);
+        detail::run_parallel_chunks(pool, chunks, [&](std::size_t chunk) {
+            const I last = begin + detail::parallel_chunk_begin(chunk + 1, chunks, size);
+            for (I it = begin + detail::parallel_chunk_begin(chunk, chunks, size); it != last; ++it)
+            {
+                function(it);
+            }
+        });
+    }
+
+    template <typename P, typename I, typename F>
+    void parallel_for(P& pool, I begin, I end, F&& function) noexcept
+    {
+        parallel_for(pool, begin, end, 0, std::forward<F>(function));
+    }
+
+    // Folds every element into a per chunk copy of identity with function(accumulated, it), then reduces
+    //  chunks in order with reduction(lhs, rhs), so it does not need to be commutative
+    template <typename P, typename I, typename T, typename F, typename R>
+    T parallel_reduce(P& pool, I begin, I end, std::size_t grain, T identity, F&& function, R&& reduction) noexcept
+    {
+        const std::size_t size = static_cast<std::size_t>(end - begin);
+        if (size == 0)
+        {
+            return identity;
+        }
+
+        const std::size_t chunks = detail::parallel_chunk_count(pool, size, grain);
+        std::vector<T> partials(chunks, identity);
+
+        detail::run_parallel_chunks(pool, chunks, [&](std::size_t chunk) {
+            T& partial = partials[chunk];
+            const I last = begin + detail::parallel_chunk_begin(chunk + 1, chunks, size);
+            for (I it = begin + detail::parallel_chunk_begin(chunk, chunks, size); it != last; ++it)
+            {
+                partial = function(std::move(partial), it);
+            }
+        });
+
+        T result = std::move(identity);
+        for (T& partial : partials)
+        {
+            result = reduction(std::move(result), std::move(partial));
+        }
+
+        return result;
+    }
+
+    template <typename P, typename I, typename T, typename F, typename R>
+    T parallel_reduce(P& pool, I begin, I end, T identity, F&& function, R&& reduction) noexcept
+    {
+        return parallel_reduce(pool, begin, end, 0, std::move(identity), std::forward<F>(function), std::forward<R>(reduction));
+    }
+
+    // Runs the first function inline and the rest in the pool, returning once all of them are done
+    template <typename P, typename F, typename... Fs>
+    void parallel_invoke(P& pool, F&& function, Fs&&... functions) noexcept
+    {
+        np::counter counter;
+        (pool.push([&functions] { functions(); }, counter), ...);
+
+        function();
+        counter.wait();
+    }
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "pool/fiber_pool.hpp"
+#include "synchronization/counter.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+#include <inplace_function.h>
+
+
+namespace np
+{
+    // Jobs and the order between them, built once and launched as many times as needed
+    //  Every node keeps an atomic count of predecessors still running, the one finishing last pushes it, so no
+    //  fiber ever blocks on a dependency. A node finishing with ready successors keeps the last of them for
+    //  itself and runs it right away, the rest are pushed
+    template <uint32_t inplace_function_size = 64>
+    class task_graph
+    {
+        using job_t = stdext::inplace_function<void(), inplace_function_size>;
+
+    public:
+        using node_id = uint32_t;
+
+        task_graph() noexcept = default;
+
+        task_graph(const task_graph&) = delete;
+        task_graph& operator=(const task_graph&) = delete;
+
+        template <typename F>
+        node_id add(F&& function) noexcept;
+
+        // Adds a node that runs once every one of dependencies is done
+        template <typename F>
+        node_id add(F&& function, std::initializer_list<node_id> dependencies) noexcept;
+
+        // after runs once before is done
+        void precede(node_id before, node_id after) noexcept;
+
+        inline std::size_t size() const noexcept;
+
+        // Pushes every node without dependencies, the counter is done once the whole graph has run
+        //  The graph can't be modified nor launched again until then
+        template <typename P>
+        void launch(P& pool, np::counter& counter) noexcept;
+
+        // Launches the graph and waits for it, must be called from a fiber
+        template <typename P>
+        void run(P& pool) noexcept;
+
+    private:
+        static constexpr node_id no_node = std::numeric_limits<node_id>::max();
+
+        struct node
+        {
+            job_t function;
+            std::vector<node_id> successors;
+            uint32_t predecessors = 0;
+            std::atomic<uint32_t> pending = 0;
+        };
+
+        template <typename P>
+        void push(P& pool, np::counter& counter, node_id id) noexcept;
+
+        // Runs id and then, as long as one becomes ready, one of its successors
+        template <typename P>
+        void execute(P& pool, np::counter& counter, node_id id) noexcept;
+
+    private:
+        // Nodes never move, they hold atomics
+        std::deque<node> _nodes;
+        // Nodes without dependencies, gathered on launch
+        std::vector<node_id> _roots;
+    };
+
+
+    template <uint32_t inplace_function_size>
+    template <typename F>
+    typename task_graph<inplace_function_size>::node_id task_graph<inplace_function_size>::add(F&& function) noexcept
+    {
+        node& added = _nodes.emplace_back();
+        added.function = std::forward<F>(function);
+        return node_id(_nodes.size() - 1);
+    }
+
+    template <uint32_t inplace_function_size>
+    template <typename F>
+    typename task_graph<inplace_function_size>::node_id task_graph<inplace_function_size>::add(F&& function, std::initializer_list<node_id> dependencies) noexcept
+    {
+        node_id id = add(std::forward<F>(function));
+        for (node_id dependency : dependencies)
+        {
+            precede(dependency, id);
+        }
+
+        return id;
+    }
+
+    template <uint32_t inplace_function_size>
+    void task_graph<inplace_function_size>::precede(node_id before, node_id after) noexcept
+    {
+        // Nodes can only depend on earlier ones, which rules out cycles
+        assert(before < after && after < _nodes.size() && "Dependencies must be added before their dependents");
+
+        _nodes[before].successors.push_back(after);
+        ++_nodes[after].predecessors;
+    }
+
+    template <uint32_t inplace_function_size>
+    inline std::size_t task_graph<inplace_function_size>::size() const noexcept
+    {
+        return _nodes.size();
+    }
+
+    template <uint32_t inplace_function_size>
+    template <typename P>
+    void task_graph<inplace_function_size>::launch(P& pool, np::counter& counter) noexcept
+    {
+        // Everything is reset before the first push, nodes may finish while roots are still being pushed
+        for (node& node : _nodes)
+        {
+            node.pending.store(node.predecessors, std::memory_order_relaxed);
+        }
+
+        _roots.clear();
+        for (node_id id = 0; id < _nodes.size(); ++id)
+        {
+            if (_nodes[id].predecessors == 0)
+            {
+                _roots.push_back(id);
+            }
+        }
+
+        // All at once, the counter is increased for every root before any of them runs, so a root finishing
+        //  its whole chain early can't bring it to zero while others are still to be pushed
+        pool.push_n(_roots.size(), [this, &pool, &counter](std::size_t index) { execute(pool, counter, _roots[index]); }, counter);
+    }
+
+    template <uint32_t inplace_function_size>
+    template <typename P>
+    void task_graph<inplace_function_size>::run(P& pool) noexcept
+    {
+        np::counter counter;
+        launch(pool, counter);
+        counter.wait();
+    }
+
+    template <uint32_t inplace_function_size>
+    template <typename P>
+    void task_graph<inplace_function_size>::push(P& pool, np::counter& counter, node_id id) noexcept
+    {
+        pool.push([this, &pool, &counter, id] { execute(pool, counter, id); }, counter);
+    }
+
+    template <uint32_t inplace_function_size>
+    template <typename P>
+    void task_graph<inplace_function_size>::execute(P& pool, np::counter& counter, node_id id) noexcept
+    {
+        // Successors are pushed before this fiber is done, so the counter can't reach zero in between
+        while (id != no_node)
+        {
+            node& current = _nodes[id];
+            current.function();
+
+            id = no_node;
+            for (node_id successor : current.successors)
+            {
+                if (_nodes[successor].pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                {
+                    continue;
+                }
+
+                if (id != no_node)
+                {
+                    push(pool, counter, id);
+                }
+
+                id = successor;
+            }
+        }
+    }
+}
@@ -0,0 +1,197 @@
+#include "bench/bench.hpp"
+#include "algorithm/parallel.hpp"
+#include "algorithm/task_graph.hpp"
+
+#include <cmath>
+#include <memory>
+
+
+namespace
+{
+    constexpr std::size_t transform_size = 1000000;
+    constexpr uint32_t transform_repetitions = 10;
+
+    // graph_layers layers of graph_width nodes, each depending on two nodes of the layer before
+    constexpr uint32_t graph_layers = 50;
+    constexpr uint32_t graph_width = 20;
+    constexpr uint32_t graph_runs = 50;
+
+    // Counter based graphs push every node up front, which then sit blocked on their predecessors
+    struct graph_traits : np::detail::default_fiber_pool_traits
+    {
+        static const uint32_t maximum_fibers = graph_layers * graph_width + 64;
+    };
+
+    inline void graph_work() noexcept
+    {
+        volatile uint32_t sink = 0;
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            sink = sink + i;
+        }
+    }
+
+    inline uint32_t graph_node(uint32_t layer, uint32_t column) noexcept
+    {
+        return layer * graph_width + column;
+    }
+
+    inline float transform_element(float value) noexcept
+    {
+        return std::sqrt(value) * 0.5f + 1.0f;
+    }
+
+    // Latency of whole graph runs, whose critical path goes through every layer
+    template <typename B>
+    void graph(const char* variant, B&& body)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            std::vector<double> latencies;
+            np::bench::run_in_pool<graph_traits>(threads, [&latencies, &body](auto& pool) {
+                auto run = body(pool);
+                for (uint32_t r = 0; r < graph_runs; ++r)
+                {
+                    auto start = np::bench::clock::now();
+                    run();
+                    latencies.push_back(std::chrono::duration<double>(np::bench::clock::now() - start).count());
+                }
+            });
+
+            np::bench::report_latencies("task_graph_1000", variant, threads, latencies);
+        }
+    }
+
+    template <typename B>
+    void transform(const char* variant, B&& body)
+    {
+        std::vector<float> input(transform_size);
+        std::vector<float> output(transform_size);
+        for (std::size_t i = 0; i < transform_size; ++i)
+        {
+            input[i] = float(i);
+        }
+
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [&](auto& pool) {
+                for (uint32_t r = 0; r < transform_repetitions; ++r)
+                {
+                    body(pool, threads, input.data(), output.data());
+                }
+            });
+
+            np::bench::report("transform_1m", variant, threads, uint64_t(transform_size) * transform_repetitions, seconds);
+        }
+    }
+}
+
+NP_BENCHMARK(transform_1m)
+{
+    // One push per element, what a plain loop over push ends up doing
+    transform("push_loop", [](auto& pool, uint16_t, const float* input, float* output) {
+        np::counter counter;
+        for (std::size_t i = 0; i < transform_size; ++i)
+        {
+            pool.push([input, output, i] { output[i] = transform_element(input[i]); }, counter);
+        }
+
+        counter.wait();
+    });
+
+    // One push per worker, chunked by hand
+    transform("push_chunks", [](auto& pool, uint16_t threads, const float* input, float* output) {
+        np::counter counter;
+        const std::size_t chunk = (transform_size + threads - 1) / threads;
+        for (std::size_t begin = 0; begin < transform_size; begin += chunk)
+        {
+            pool.push([input, output, begin, end = std::min(begin + chunk, transform_size)] {
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    output[i] = transform_element(input[i]);
+                }
+            }, counter);
+        }
+
+        counter.wait();
+    });
+
+    transform("parallel_for", [](auto& pool, uint16_t, const float* input, float* output) {
+        np::parallel_for(pool, std::size_t(0), transform_size, [input, output](std::size_t i) {
+            output[i] = transform_element(input[i]);
+        });
+    });
+
+    transform("parallel_for_g1024", [](auto& pool, uint16_t, const float* input, float* output) {
+        np::parallel_for(pool, std::size_t(0), transform_size, 1024, [input, output](std::size_t i) {
+            output[i] = transform_element(input[i]);
+        });
+    });
+}
+
+NP_BENCHMARK(task_graph_1000)
+{
+    // Built once, successors are pushed by whoever finishes their last predecessor
+    graph("task_graph", [](auto& pool) {
+        auto graph = std::make_unique<np::task_graph<>>();
+        for (uint32_t layer = 0; layer < graph_layers; ++layer)
+        {
+            for (uint32_t column = 0; column < graph_width; ++column)
+            {
+                if (layer == 0)
+                {
+                    graph->add(graph_work);
+                }
+                else
+                {
+                    graph->add(graph_work, { graph_node(layer - 1, column), graph_node(layer - 1, (column + 1) % graph_width) });
+                }
+            }
+        }
+
+        return [graph = std::move(graph), &pool] { graph->run(pool); };
+    });
+
+    // Every node is pushed as soon as possible and waits on its predecessors' counters
+    graph("counter_waits", [](auto& pool) {
+        return [&pool] {
+            std::vector<np::counter> counters(graph_layers * graph_width);
+            for (uint32_t layer = 0; layer < graph_layers; ++layer)
+            {
+                for (uint32_t column = 0; column < graph_width; ++column)
+                {
+                    pool.push([&counters, layer, column] {
+                        if (layer != 0)
+                        {
+                            counters[graph_node(layer - 1, column)].wait();
+                            counters[graph_node(layer - 1, (column + 1) % graph_width)].wait();
+                        }
+
+                        graph_work();
+                    }, counters[graph_node(layer, column)]);
+                }
+            }
+
+            for (np::counter& counter : counters)
+            {
+                counter.wait();
+            }
+        };
+    });
+
+    // The caller waits for a layer before pushing the next one
+    graph("layer_waits", [](auto& pool) {
+        return [&pool] {
+            for (uint32_t layer = 0; layer < graph_layers; ++layer)
+            {
+                np::counter counter;
+                for (uint32_t column = 0; column < graph_width; ++column)
+                {
+                    pool.push(graph_work, counter);
+                }
+
+                counter.wait();
+            }
+        };
+    });
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "pool/fiber_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+
+namespace np
+{
+    namespace bench
+    {
+        using clock = std::chrono::steady_clock;
+
+        struct benchmark
+        {
+            const char* name;
+            void(*function)();
+        };
+
+        inline std::vector<benchmark>& benchmarks() noexcept
+        {
+            static std::vector<benchmark> all;
+            return all;
+        }
+
+        // Every reported number, kept for the json output
+        struct result
+        {
+            std::string benchmark;
+            std::string variant;
+            uint16_t threads;
+            std::string metric;
+            double value;
+            std::string unit;
+        };
+
+        inline std::vector<result>& results() noexcept
+        {
+            static std::vector<result> all;
+            return all;
+        }
+
+        struct registrar
+        {
+            registrar(const char* name, void(*function)()) noexcept
+            {
+                benchmarks().push_back({ name, function });
+            }
+        };
+
+        // 1, 2, 4... up to the hardware concurrency, which is always included
+        inline std::vector<uint16_t> thread_counts() noexcept
+        {
+            std::vector<uint16_t> counts;
+            uint16_t maximum = std::max<uint16_t>(1, std::thread::hardware_concurrency());
+            for (uint16_t threads = 1; threads < maximum; threads *= 2)
+            {
+                counts.push_back(threads);
+            }
+
+            counts.push_back(maximum);
+            return counts;
+        }
+
+        inline void report(const char* name, const char* variant, uint16_t threads, uint64_t operations, double seconds) noexcept
+        {
+            std::printf("%-28s %-20s threads=%-4u ops=%-10llu %10.3f ms %14.0f ops/s\n",
+                name, variant, threads, (unsigned long long)operations, seconds * 1000.0, operations / seconds);
+            std::fflush(stdout);
+
+            results().push_back({ name, variant, threads, "throughput", operations / seconds, "ops/s" });
+        }
+
+        inline void report_metric(const char* name, const char* variant, uint16_t threads, const char* metric, double value, const char* unit) noexcept
+        {
+            std::printf("%-28s %-20s threads=%-4u %-18s %14.3f %s\n", name, variant, threads, metric, value, unit);
+            std::fflush(stdout);
+
+            results().push_back({ name, variant, threads, metric, value, unit });
+        }
+
+        // Reports the median and 99th percentile of samples given in seconds, sorting them in the process
+        //  Nothing is reported without samples
+        inline void report_latencies(const char* name, const char* variant, uint16_t threads, std::vector<double>& latencies) noexcept
+        {
+            if (latencies.empty())
+            {
+                return;
+            }
+
+            std::sort(latencies.begin(), latencies.end());
+            report_metric(name, variant, threads, "p50", latencies[latencies.size() / 2] * 1e6, "us");
+            report_metric(name, variant, threads, "p99", latencies[latencies.size() * 99 / 100] * 1e6, "us");
+        }
+
+        // Only benchmark names and variants end up in strings, quotes and backslashes are all there is to escape
+        inline void write_json_string(FILE* file, const std::string& value) noexcept
+        {
+            std::fputc('"', file);
+            for (char c : value)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    std::fputc('\\', file);
+                }
+
+                std::fputc(c, file);
+            }
+            std::fputc('"', file);
+        }
+
+        inline void write_json(FILE* file) noexcept
+        {
+#if defined(NDEBUG)
+            const char* build = "release";
+#else
+            const char* build = "debug";
+#endif
+
+            std::fprintf(file, "{\n  \"hardware_concurrency\": %u,\n  \"build\": \"%s\",\n  \"results\": [", std::thread::hardware_concurrency(), build);
+            for (std::size_t i = 0; i < results().size(); ++i)
+            {
+                const result& r = results()[i];
+                std::fprintf(file, "%s\n    { \"benchmark\": ", i == 0 ? "" : ",");
+                write_json_string(file, r.benchmark);
+                std::fprintf(file, ", \"variant\": ");
+                write_json_string(file, r.variant);
+                std::fprintf(file, ", \"threads\": %u, \"metric\": ", unsigned(r.threads));
+                write_json_string(file, r.metric);
+                if (std::isfinite(r.value))
+                {
+                    std::fprintf(file, ", \"value\": %.6g, \"unit\": ", r.value);
+                }
+                else
+                {
+                    std::fprintf(file, ", \"value\": null, \"unit\": ");
+                }
+                write_json_string(file, r.unit);
+                std::fprintf(file, " }");
+            }
+            std::fprintf(file, "\n  ]\n}\n");
+        }
+
+        // Resident set size of the whole process, or 0 where it can't be queried
+        inline std::size_t resident_bytes() noexcept
+        {
+#if defined(__linux__)
+            unsigned long long total = 0, resident = 0;
+            if (FILE* statm = std::fopen("/proc/self/statm", "r"))
+            {
+                if (std::fscanf(statm, "%llu %llu", &total, &resident) != 2)
+                {
+                    resident = 0;
+                }
+
+                std::fclose(statm);
+            }
+
+            return static_cast<std::size_t>(resident) * sysconf(_SC_PAGESIZE);
+#else
+            return 0;
+#endif
+        }
+
+        // Runs body as the first fiber of a fresh pool, returning how long it took
+        template <typename traits, typename F>
+        double run_in_pool(uint16_t threads, F&& body) noexcept
+        {
+            np::fiber_pool<traits> pool;
+            double seconds = 0;
+
+            pool.push([&pool, &body, &seconds] {
+                auto start = clock::now();
+                body(pool);
+                seconds = std::chrono::duration<double>(clock::now() - start).count();
+                pool.end();
+            });
+
+            pool.start(threads);
+            pool.join();
+            return seconds;
+        }
+    }
+}
+
+#define NP_BENCHMARK(name)                                                      \
+    static void name();                                                         \
+    static np::bench::registrar name##_registrar(#name, &name);                 \
+    static void name()
@@ -0,0 +1,39 @@
+#include "bench/bench.hpp"
+#include "core/fiber.hpp"
+
+
+namespace
+{
+    constexpr uint32_t context_round_trips = 1000000;
+    constexpr std::size_t context_stack_size = 64 * 1024;
+
+    // A bare fiber bounces back to this thread, so there is no pool, queue or thread_index lookup involved
+    //  Every round trip is one resume and one yield, both through ontop_fcontext
+    void resume_yield()
+    {
+        np::fiber<> thread_context("Bench/%d", context_stack_size, np::empty_fiber_t{});
+        np::fiber<> bouncer("Bench/%d", context_stack_size, np::empty_fiber_t{});
+
+        // Never returns, it is destroyed while suspended
+        bouncer.reset([&thread_context, &bouncer] {
+            for (;;)
+            {
+                bouncer.yield(&thread_context);
+            }
+        });
+
+        auto start = np::bench::clock::now();
+        for (uint32_t i = 0; i < context_round_trips; ++i)
+        {
+            thread_context.resume(&bouncer);
+        }
+        double seconds = std::chrono::duration<double>(np::bench::clock::now() - start).count();
+
+        np::bench::report_metric("context_switch", "resume_yield", 1, "per_switch", seconds * 1e9 / (2.0 * context_round_trips), "ns");
+    }
+}
+
+NP_BENCHMARK(context_switch)
+{
+    resume_yield();
+}
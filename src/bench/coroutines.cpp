@@ -0,0 +1,155 @@
+#include "bench/bench.hpp"
+#include "synchronization/one_way_barrier.hpp"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+
+namespace
+{
+    constexpr uint32_t parked_requests = 10000;
+    constexpr uint32_t switch_yields = 20000;
+    constexpr uint32_t switch_awaits = 200000;
+
+    // Fibers are created as requests come in, so that their stacks show up in the measurement
+    struct request_traits : np::detail::default_fiber_pool_traits
+    {
+        static const bool preemtive_fiber_creation = false;
+        static const uint32_t maximum_fibers = parked_requests + 64;
+    };
+
+    np::task<> parked_request(np::one_way_barrier& gate, std::atomic<uint32_t>& parked)
+    {
+        parked.fetch_add(1, std::memory_order_relaxed);
+        co_await gate.wait_async();
+    }
+
+    np::task<> yielding_task()
+    {
+        for (uint32_t y = 0; y < switch_yields; ++y)
+        {
+            co_await np::this_task::yield();
+        }
+    }
+
+    np::task<uint32_t> trivial_task(uint32_t value)
+    {
+        co_return value + 1;
+    }
+
+    np::task<> awaiting_task(std::atomic<uint64_t>& sink)
+    {
+        uint32_t value = 0;
+        for (uint32_t i = 0; i < switch_awaits; ++i)
+        {
+            value = co_await trivial_task(value);
+        }
+
+        sink.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // parked_requests handlers all wait on one gate, resident memory is sampled once every one of them is parked
+    template <bool coroutines>
+    void concurrent_requests(const char* variant)
+    {
+        uint16_t threads = np::bench::thread_counts().back();
+        std::size_t parked_bytes = 0;
+
+        double seconds = np::bench::run_in_pool<request_traits>(threads, [&parked_bytes](auto& pool) {
+            np::one_way_barrier gate(1);
+            std::atomic<uint32_t> parked = 0;
+            np::counter requests;
+
+            // Memory freed by earlier benchmarks would otherwise hold the coroutine frames without growing the RSS
+#if defined(__GLIBC__)
+            malloc_trim(0);
+#endif
+            std::size_t before = np::bench::resident_bytes();
+            for (uint32_t i = 0; i < parked_requests; ++i)
+            {
+                if constexpr (coroutines)
+                {
+                    pool.spawn(parked_request(gate, parked), requests);
+                }
+                else
+                {
+                    pool.push([&gate, &parked] {
+                        parked.fetch_add(1, std::memory_order_relaxed);
+                        gate.wait();
+                    }, requests);
+                }
+            }
+
+            while (parked.load(std::memory_order_relaxed) != parked_requests)
+            {
+                np::this_fiber::yield();
+            }
+
+            parked_bytes = np::bench::resident_bytes() - before;
+            gate.decrease();
+            requests.wait();
+        });
+
+        np::bench::report_metric("concurrent_requests", variant, threads, "bytes_per_request", double(parked_bytes) / parked_requests, "B");
+        np::bench::report("concurrent_requests", variant, threads, parked_requests, seconds);
+    }
+
+    // One yielding fiber or task per worker, as in yield_round_trip
+    template <bool coroutines>
+    void switch_cost(const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [threads](auto& pool) {
+                np::counter counter;
+                for (uint16_t i = 0; i < threads; ++i)
+                {
+                    if constexpr (coroutines)
+                    {
+                        pool.spawn(yielding_task(), counter);
+                    }
+                    else
+                    {
+                        pool.push([] {
+                            for (uint32_t y = 0; y < switch_yields; ++y)
+                            {
+                                np::this_fiber::yield();
+                            }
+                        }, counter);
+                    }
+                }
+
+                counter.wait();
+            });
+
+            np::bench::report_metric("switch_cost", variant, threads, "per_yield", seconds * 1e9 / switch_yields, "ns");
+        }
+    }
+
+    // Awaiting a task that returns right away, which allocates its frame and transfers there and back
+    void await_cost()
+    {
+        std::atomic<uint64_t> sink = 0;
+        double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(1, [&sink](auto& pool) {
+            np::counter counter;
+            pool.spawn(awaiting_task(sink), counter);
+            counter.wait();
+        });
+
+        np::bench::report_metric("switch_cost", "task_await", 1, "per_await", seconds * 1e9 / switch_awaits, "ns");
+    }
+}
+
+NP_BENCHMARK(concurrent_requests)
+{
+    concurrent_requests<false>("fiber");
+    concurrent_requests<true>("task");
+}
+
+NP_BENCHMARK(switch_cost)
+{
+    switch_cost<false>("fiber_yield");
+    switch_cost<true>("task_yield");
+    await_cost();
+}
@@ -0,0 +1,100 @@
+#include "bench/bench.hpp"
+#include "ext/channel.hpp"
+#include "ext/executor.hpp"
+
+#include <string>
+
+
+namespace
+{
+    constexpr uint32_t channel_items = 200000;
+    constexpr uint32_t executor_jobs = 200000;
+
+    // producers fibers push_blocking into one channel, drained by a single consumer fiber
+    void channel_throughput(uint32_t producers)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [producers](auto& pool) {
+                np::channel<uint64_t> channel;
+                uint64_t sum = 0;
+
+                np::counter counter;
+                pool.push([&channel, &sum, producers] {
+                    for (uint32_t i = 0; i < (channel_items / producers) * producers; ++i)
+                    {
+                        uint64_t value = 0;
+                        channel.pop_blocking(value);
+                        sum += value;
+                    }
+                }, counter);
+
+                for (uint32_t p = 0; p < producers; ++p)
+                {
+                    pool.push([&channel, producers] {
+                        for (uint64_t i = 0; i < channel_items / producers; ++i)
+                        {
+                            channel.push_blocking(uint64_t(i));
+                        }
+                    }, counter);
+                }
+
+                counter.wait();
+            });
+
+            std::string variant = std::to_string(producers) + "p/1c";
+            np::bench::report("channel_throughput", variant.c_str(), threads, (channel_items / producers) * producers, seconds);
+        }
+    }
+
+    // producers fibers push empty jobs to an executor running on one fiber
+    //  It is stopped from a job of its own, otherwise a late start could miss the stop
+    void executor_throughput(uint32_t producers)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [producers](auto& pool) {
+                np::executor<> executor;
+                uint64_t executed = 0;
+
+                np::counter runner;
+                pool.push([&executor] { executor.start(); }, runner);
+
+                np::counter counter;
+                for (uint32_t p = 0; p < producers; ++p)
+                {
+                    pool.push([&executor, &executed, producers] {
+                        for (uint32_t i = 0; i < executor_jobs / producers; ++i)
+                        {
+                            executor.push([&executed] { ++executed; });
+                        }
+                    }, counter);
+                }
+
+                counter.wait();
+                executor.push([&executor] { executor.stop(); });
+                runner.wait();
+            });
+
+            std::string variant = std::to_string(producers) + "p";
+            np::bench::report("executor_throughput", variant.c_str(), threads, (executor_jobs / producers) * producers, seconds);
+        }
+    }
+}
+
+// Producers in the variant name, there is always a single consumer
+NP_BENCHMARK(channel_throughput)
+{
+    for (uint32_t producers : { 1u, 4u, 16u })
+    {
+        channel_throughput(producers);
+    }
+}
+
+NP_BENCHMARK(executor_throughput)
+{
+    for (uint32_t producers : { 1u, 4u, 16u })
+    {
+        executor_throughput(producers);
+    }
+}
@@ -0,0 +1,78 @@
+#include "bench/bench.hpp"
+
+#include <ctime>
+
+
+namespace
+{
+    using namespace std::chrono_literals;
+
+    struct spin_idle_traits : np::detail::default_fiber_pool_traits
+    {
+        static const uint32_t idle_spin_iterations = std::numeric_limits<uint32_t>::max();
+        static const bool idle_park = false;
+    };
+
+    struct yield_idle_traits : np::detail::default_fiber_pool_traits
+    {
+        static const uint32_t idle_spin_iterations = 0;
+        static const bool idle_park = false;
+    };
+
+    using park_idle_traits = np::detail::default_fiber_pool_traits;
+
+    constexpr uint32_t wake_up_samples = 100;
+
+    // Workers run on their own threads while this thread measures them from outside
+    template <typename traits>
+    void idle_policy(const char* variant)
+    {
+        uint16_t threads = np::bench::thread_counts().back();
+
+        np::fiber_pool<traits> pool;
+        pool.start(threads, false);
+
+        // Give every dispatcher time to go through spinning and yielding
+        std::this_thread::sleep_for(50ms);
+
+        auto wall_start = np::bench::clock::now();
+        std::clock_t cpu_start = std::clock();
+        std::this_thread::sleep_for(250ms);
+        double cpu = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        double wall = std::chrono::duration<double>(np::bench::clock::now() - wall_start).count();
+        np::bench::report_metric("idle_cpu", variant, threads, "cores_busy", cpu / wall, "cores");
+
+        std::vector<double> latencies;
+        for (uint32_t i = 0; i < wake_up_samples; ++i)
+        {
+            std::this_thread::sleep_for(2ms);
+
+            std::atomic<bool> done = false;
+            np::bench::clock::time_point started;
+            auto pushed = np::bench::clock::now();
+            pool.push([&started, &done] {
+                started = np::bench::clock::now();
+                done.store(true, std::memory_order_release);
+            });
+
+            while (!done.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+
+            latencies.push_back(std::chrono::duration<double>(started - pushed).count());
+        }
+
+        np::bench::report_latencies("wake_up_latency", variant, threads, latencies);
+
+        pool.end();
+        pool.join();
+    }
+}
+
+NP_BENCHMARK(idle_policy)
+{
+    idle_policy<spin_idle_traits>("spin");
+    idle_policy<yield_idle_traits>("yield");
+    idle_policy<park_idle_traits>("park");
+}
@@ -0,0 +1,61 @@
+#define PL_IMPLEMENTATION 1
+#include <palanteer.h>
+
+#include "bench/bench.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+// Usage: tamashii_bench [--json file] [benchmark...], runs everything when no name is given
+//  Results are also written to file as json, so that runs can be compared between releases
+int main(int argc, char** argv)
+{
+    spdlog::set_level(spdlog::level::level_enum::critical);
+
+    const char* json_path = nullptr;
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else
+        {
+            names.push_back(argv[i]);
+        }
+    }
+
+    for (auto& benchmark : np::bench::benchmarks())
+    {
+        bool selected = names.empty();
+        for (const char* name : names)
+        {
+            selected = selected || std::strcmp(name, benchmark.name) == 0;
+        }
+
+        if (selected)
+        {
+            benchmark.function();
+        }
+    }
+
+    if (json_path)
+    {
+        FILE* file = std::fopen(json_path, "w");
+        if (!file)
+        {
+            std::fprintf(stderr, "Could not open %s\n", json_path);
+            return 1;
+        }
+
+        np::bench::write_json(file);
+        std::fclose(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "bench/bench.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+#if defined(__linux__)
+    struct stack_pages
+    {
+        std::size_t total = 0;
+        std::size_t resident = 0;
+        std::size_t local = 0;
+    };
+
+    // Whether the calling thread may only run on cpu
+    bool pinned_to(uint16_t cpu) noexcept
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        return pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0 && CPU_COUNT(&set) == 1 && CPU_ISSET(cpu, &set);
+    }
+
+    // Where the pages of a stack sit, move_pages without target nodes only reports it, and pages not
+    //  committed yet come back negative. Nothing is counted if the kernel won't tell
+    stack_pages placement_of(const np::stack_context& stack, int node) noexcept
+    {
+        const std::size_t page_size = sysconf(_SC_PAGESIZE);
+        char* top = static_cast<char*>(stack.top);
+
+        std::vector<void*> pages;
+        for (std::size_t offset = page_size; offset <= stack.size; offset += page_size)
+        {
+            pages.push_back(top - offset);
+        }
+
+        std::vector<int> status(pages.size(), 0);
+        stack_pages placement;
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0)
+        {
+            return placement;
+        }
+
+        placement.total = pages.size();
+        for (int page_node : status)
+        {
+            placement.resident += page_node >= 0;
+            placement.local += page_node == node;
+        }
+
+        return placement;
+    }
+#endif
+}
+
+// One pinned worker per physical core, every one of them checks its own affinity mask and where the stack
+//  of the fiber running the check was placed. Stacks are only committed upfront in pools spanning nodes, on a
+//  single node most of their pages are not resident yet
+NP_BENCHMARK(worker_placement)
+{
+#if defined(__linux__)
+    const np::worker_affinity affinity = np::worker_affinity::physical_cores();
+    const uint16_t threads = uint16_t(affinity.size());
+
+    np::fiber_pool<> pool;
+    std::atomic<uint32_t> pinned_workers = 0;
+    std::atomic<std::size_t> total = 0;
+    std::atomic<std::size_t> resident = 0;
+    std::atomic<std::size_t> local = 0;
+
+    pool.push([&] {
+        np::counter checks;
+        const auto& worker_ids = pool.worker_ids();
+        for (std::size_t ordinal = 0; ordinal < threads; ++ordinal)
+        {
+            pool.push_to(worker_ids[ordinal], [&, ordinal] {
+                const np::cpu_info& cpu = affinity[ordinal];
+                pinned_workers.fetch_add(uint32_t(pinned_to(cpu.cpu)), std::memory_order_relaxed);
+
+                const stack_pages placement = placement_of(np::this_fiber::instance()->stack(), cpu.node);
+                total.fetch_add(placement.total, std::memory_order_relaxed);
+                resident.fetch_add(placement.resident, std::memory_order_relaxed);
+                local.fetch_add(placement.local, std::memory_order_relaxed);
+            }, checks);
+        }
+
+        checks.wait();
+        pool.end();
+    });
+
+    pool.start(threads, true, affinity);
+    pool.join();
+
+    np::bench::report_metric("worker_placement", "physical_cores", threads, "pinned_workers", double(pinned_workers), "");
+    if (total != 0)
+    {
+        np::bench::report_metric("worker_placement", "physical_cores", threads, "stack_pages_resident", 100.0 * resident / total, "%");
+        np::bench::report_metric("worker_placement", "physical_cores", threads, "resident_pages_local", resident ? 100.0 * local / resident : 100.0, "%");
+    }
+#endif
+}
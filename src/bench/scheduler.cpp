@@ -0,0 +1,347 @@
+#include "bench/bench.hpp"
+
+#include <array>
+
+
+namespace
+{
+    struct work_stealing_traits : np::detail::default_fiber_pool_traits
+    {
+        static const bool work_stealing = true;
+    };
+
+    struct lazy_binding_traits : np::detail::default_fiber_pool_traits
+    {
+        static const bool lazy_fiber_binding = true;
+    };
+
+    constexpr uint32_t dispatch_tasks = 256;
+    constexpr uint32_t dispatch_yields = 200;
+    constexpr uint32_t round_trip_yields = 20000;
+    constexpr uint32_t fan_out_tasks = 10000;
+    constexpr uint32_t fan_out_frames = 20;
+
+    // Fibers are only created when needed, so the number of them is how many stacks tasks tied up
+    struct on_demand_traits : np::detail::default_fiber_pool_traits
+    {
+        static const bool preemtive_fiber_creation = false;
+        static const uint32_t maximum_fibers = fan_out_tasks + 64;
+    };
+
+    struct on_demand_lazy_traits : on_demand_traits
+    {
+        static const bool lazy_fiber_binding = true;
+    };
+    constexpr uint32_t completion_tasks = 1000000;
+    constexpr uint32_t closure_tasks = 200000;
+    constexpr uint32_t closure_batch = 1000;
+    constexpr uint32_t push_latency_samples = 20000;
+    constexpr uint32_t priority_background_per_thread = 64;
+    constexpr uint32_t priority_samples = 2000;
+    constexpr auto priority_sample_interval = std::chrono::microseconds(200);
+
+    // Every task yields back to the dispatcher, so each run is dominated by run queue operations
+    template <typename traits>
+    void dispatch_throughput(const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<traits>(threads, [](auto& pool) {
+                np::counter counter;
+                for (uint32_t i = 0; i < dispatch_tasks; ++i)
+                {
+                    pool.push([] {
+                        for (uint32_t y = 0; y < dispatch_yields; ++y)
+                        {
+                            np::this_fiber::yield();
+                        }
+                    }, counter);
+                }
+
+                counter.wait();
+            });
+
+            np::bench::report("dispatch_throughput", variant, threads, uint64_t(dispatch_tasks) * (dispatch_yields + 1), seconds);
+        }
+    }
+
+    // One yielding fiber per worker, so every yield pays the thread_index lookups and a queue round-trip
+    template <typename traits>
+    void yield_round_trip(const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<traits>(threads, [threads](auto& pool) {
+                np::counter counter;
+                for (uint16_t i = 0; i < threads; ++i)
+                {
+                    pool.push([] {
+                        for (uint32_t y = 0; y < round_trip_yields; ++y)
+                        {
+                            np::this_fiber::yield();
+                        }
+                    }, counter);
+                }
+
+                counter.wait();
+            });
+
+            np::bench::report_metric("yield_round_trip", variant, threads, "per_yield", seconds * 1e9 / round_trip_yields, "ns");
+        }
+    }
+
+    // One frame pushes fan_out_tasks trivial tasks and waits for them, either one by one or in bulk
+    //  Along with the time goes the number of fibers the pool ended up with
+    template <typename traits, bool bulk>
+    void fan_out(const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            std::size_t fibers = 0;
+            double seconds = np::bench::run_in_pool<traits>(threads, [&fibers](auto& pool) {
+                std::atomic<uint32_t> sum = 0;
+                for (uint32_t frame = 0; frame < fan_out_frames; ++frame)
+                {
+                    np::counter counter;
+                    if constexpr (bulk)
+                    {
+                        pool.push_n(fan_out_tasks, [&sum](std::size_t i) { sum.fetch_add(uint32_t(i), std::memory_order_relaxed); }, counter);
+                    }
+                    else
+                    {
+                        for (uint32_t i = 0; i < fan_out_tasks; ++i)
+                        {
+                            pool.push([&sum, i] { sum.fetch_add(i, std::memory_order_relaxed); }, counter);
+                        }
+                    }
+
+                    counter.wait();
+                }
+
+                fibers = pool.stats().spawned_fibers;
+            });
+
+            np::bench::report("fan_out", variant, threads, uint64_t(fan_out_tasks) * fan_out_frames, seconds);
+            np::bench::report_metric("fan_out", variant, threads, "fibers", double(fibers), "");
+        }
+    }
+
+    // Empty tasks against one counter, waited on from a fiber or from a thread outside of the pool
+    template <bool from_thread>
+    void counter_completion(const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = 0;
+            if constexpr (from_thread)
+            {
+                np::fiber_pool<np::detail::default_fiber_pool_traits> pool;
+                pool.start(threads, false);
+
+                auto start = np::bench::clock::now();
+                np::counter counter;
+                pool.push_n(completion_tasks, [](std::size_t) {}, counter);
+                counter.wait();
+                seconds = std::chrono::duration<double>(np::bench::clock::now() - start).count();
+
+                pool.end();
+                pool.join();
+            }
+            else
+            {
+                seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [](auto& pool) {
+                    np::counter counter;
+                    pool.push_n(completion_tasks, [](std::size_t) {}, counter);
+                    counter.wait();
+                });
+            }
+
+            np::bench::report("counter_completion", variant, threads, completion_tasks, seconds);
+        }
+    }
+
+    // Tasks capturing a payload of the given size, which decides where the pool stores them
+    //  They are pushed in batches, so that storage gets reused as it would in a steady state. Boxed tasks allocate their payload themselves, as large closures had to before the pool stored them
+    template <std::size_t size, bool boxed>
+    void closure_size(const char* variant)
+    {
+        using payload_t = std::array<uint64_t, (size - sizeof(void*)) / sizeof(uint64_t)>;
+
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            std::atomic<uint64_t> sum = 0;
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [&sum](auto& pool) {
+                payload_t payload {};
+                for (uint32_t batch = 0; batch < closure_tasks / closure_batch; ++batch)
+                {
+                    np::counter counter;
+                    for (uint32_t i = 0; i < closure_batch; ++i)
+                    {
+                        payload[0] = i;
+                        if constexpr (boxed)
+                        {
+                            pool.push([&sum, state = new payload_t(payload)] {
+                                sum.fetch_add((*state)[0], std::memory_order_relaxed);
+                                delete state;
+                            }, counter);
+                        }
+                        else
+                        {
+                            pool.push([&sum, payload] { sum.fetch_add(payload[0], std::memory_order_relaxed); }, counter);
+                        }
+                    }
+
+                    counter.wait();
+                }
+            });
+
+            np::bench::report("closure_size", variant, threads, (closure_tasks / closure_batch) * closure_batch, seconds);
+        }
+    }
+
+    // One task in flight at a time, so workers are awake and latency goes from the push until it starts running
+    //  Pushes come either from a fiber, which waits on a counter, or from a thread outside of the pool that spins
+    template <bool from_thread>
+    void push_latency(const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            std::vector<double> latencies(push_latency_samples);
+
+            if constexpr (from_thread)
+            {
+                np::fiber_pool<np::detail::default_fiber_pool_traits> pool;
+                pool.start(threads, false);
+
+                for (uint32_t i = 0; i < push_latency_samples; ++i)
+                {
+                    std::atomic<bool> done = false;
+                    double* latency = &latencies[i];
+                    auto pushed = np::bench::clock::now();
+                    pool.push([latency, pushed, &done] {
+                        *latency = std::chrono::duration<double>(np::bench::clock::now() - pushed).count();
+                        done.store(true, std::memory_order_release);
+                    });
+
+                    while (!done.load(std::memory_order_acquire))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+
+                pool.end();
+                pool.join();
+            }
+            else
+            {
+                np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [&latencies](auto& pool) {
+                    for (uint32_t i = 0; i < push_latency_samples; ++i)
+                    {
+                        np::counter counter;
+                        double* latency = &latencies[i];
+                        auto pushed = np::bench::clock::now();
+                        pool.push([latency, pushed] {
+                            *latency = std::chrono::duration<double>(np::bench::clock::now() - pushed).count();
+                        }, counter);
+
+                        counter.wait();
+                    }
+                });
+            }
+
+            np::bench::report_latencies("push_latency", variant, threads, latencies);
+        }
+    }
+
+    // Workers are saturated by yielding fibers while probes are pushed every priority_sample_interval
+    //  Latency goes from the push until the probe starts running
+    void priority_latency(np::priority priority, const char* variant)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            std::vector<double> latencies(priority_samples);
+
+            np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [threads, priority, &latencies](auto& pool) {
+                std::atomic<bool> done = false;
+                np::counter background;
+                for (uint32_t i = 0; i < threads * priority_background_per_thread; ++i)
+                {
+                    pool.push([&done] {
+                        while (!done.load(std::memory_order_relaxed))
+                        {
+                            np::this_fiber::yield();
+                        }
+                    }, background);
+                }
+
+                np::counter probes;
+                for (uint32_t i = 0; i < priority_samples; ++i)
+                {
+                    double* latency = &latencies[i];
+                    auto pushed = np::bench::clock::now();
+                    pool.push([latency, pushed] {
+                        *latency = std::chrono::duration<double>(np::bench::clock::now() - pushed).count();
+                    }, probes, priority);
+
+                    np::this_fiber::sleep_for(priority_sample_interval);
+                }
+
+                probes.wait();
+                done = true;
+                background.wait();
+            });
+
+            np::bench::report_latencies("priority_latency", variant, threads, latencies);
+        }
+    }
+}
+
+NP_BENCHMARK(dispatch_throughput)
+{
+    dispatch_throughput<np::detail::default_fiber_pool_traits>("shared_queue");
+    dispatch_throughput<work_stealing_traits>("work_stealing");
+    dispatch_throughput<lazy_binding_traits>("lazy_binding");
+}
+
+NP_BENCHMARK(yield_round_trip)
+{
+    yield_round_trip<np::detail::default_fiber_pool_traits>("shared_queue");
+    yield_round_trip<work_stealing_traits>("work_stealing");
+    yield_round_trip<lazy_binding_traits>("lazy_binding");
+}
+
+NP_BENCHMARK(fan_out)
+{
+    fan_out<np::detail::default_fiber_pool_traits, false>("push");
+    fan_out<np::detail::default_fiber_pool_traits, true>("push_n");
+    fan_out<on_demand_traits, false>("push_on_demand");
+    fan_out<on_demand_lazy_traits, false>("push_lazy");
+    fan_out<on_demand_lazy_traits, true>("push_n_lazy");
+}
+
+NP_BENCHMARK(counter_completion)
+{
+    counter_completion<false>("fiber_wait");
+    counter_completion<true>("thread_wait");
+}
+
+// Inline up to inplace_function_size, pooled blocks up to task_storage_size, heap past that
+NP_BENCHMARK(closure_size)
+{
+    closure_size<48, false>("inline_48B");
+    closure_size<192, false>("pooled_192B");
+    closure_size<192, true>("boxed_192B");
+    closure_size<1024, false>("heap_1KB");
+}
+
+NP_BENCHMARK(push_latency)
+{
+    push_latency<false>("from_fiber");
+    push_latency<true>("from_thread");
+}
+
+NP_BENCHMARK(priority_latency)
+{
+    priority_latency(np::priority::normal, "normal");
+    priority_latency(np::priority::high, "high");
+}
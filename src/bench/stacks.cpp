@@ -0,0 +1,91 @@
+#include "bench/bench.hpp"
+
+
+namespace
+{
+    constexpr uint32_t mixed_tasks = 20000;
+    constexpr uint32_t deep_task_every = 10;
+    constexpr uint32_t deep_task_depth = 64;
+
+    // Every fiber worst-case sized, as with a single fiber_stack_size
+    struct single_class_traits : np::detail::default_fiber_pool_traits
+    {
+        static constexpr std::array<np::stack_size_class, 1> stack_size_classes = { {
+            { 1024 * 1024, 300 }
+        } };
+    };
+
+    // Same number of fibers, but only a few of them get the big stack
+    struct mixed_class_traits : np::detail::default_fiber_pool_traits
+    {
+        static constexpr std::array<np::stack_size_class, 2> stack_size_classes = { {
+            { 16 * 1024, 256 },
+            { 1024 * 1024, 44 }
+        } };
+    };
+
+    // Touches about depth * 4 KiB of stack
+    NP_NOINLINE uint32_t touch_stack(uint32_t depth) noexcept
+    {
+        volatile char buffer[4096];
+        buffer[0] = static_cast<char>(depth);
+        buffer[sizeof(buffer) - 1] = static_cast<char>(depth);
+
+        if (depth == 0)
+        {
+            return buffer[0];
+        }
+
+        return touch_stack(depth - 1) + buffer[sizeof(buffer) - 1];
+    }
+
+    template <typename traits>
+    void mixed_stacks(const char* variant)
+    {
+        using pool_t = np::fiber_pool<traits>;
+
+        std::size_t reserved = 0;
+        for (const auto& stack_size_class : pool_t::stack_size_classes)
+        {
+            reserved += std::size_t(stack_size_class.stack_size) * stack_size_class.maximum_fibers;
+        }
+
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            std::size_t resident_before = np::bench::resident_bytes();
+            std::size_t resident_peak = 0;
+
+            double seconds = np::bench::run_in_pool<traits>(threads, [&resident_peak](auto& pool) {
+                constexpr np::stack_class small_stack = pool_t::stack_class_for(16 * 1024);
+                constexpr np::stack_class big_stack = pool_t::stack_class_for(1024 * 1024);
+
+                np::counter counter;
+                for (uint32_t i = 0; i < mixed_tasks; ++i)
+                {
+                    if (i % deep_task_every == 0)
+                    {
+                        pool.push([] { touch_stack(deep_task_depth); }, counter, big_stack);
+                    }
+                    else
+                    {
+                        pool.push([] { touch_stack(1); }, counter, small_stack);
+                    }
+                }
+
+                counter.wait();
+                resident_peak = np::bench::resident_bytes();
+            });
+
+            np::bench::report("mixed_stacks", variant, threads, mixed_tasks, seconds);
+            np::bench::report_metric("mixed_stacks", variant, threads, "stack_reserved", reserved / 1048576.0, "MiB");
+            np::bench::report_metric("mixed_stacks", variant, threads, "resident_growth",
+                (resident_peak > resident_before ? resident_peak - resident_before : 0) / 1048576.0, "MiB");
+        }
+    }
+}
+
+NP_BENCHMARK(mixed_stacks)
+{
+    mixed_stacks<single_class_traits>("single_class");
+    mixed_stacks<mixed_class_traits>("mixed_classes");
+}
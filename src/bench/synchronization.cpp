@@ -0,0 +1,222 @@
+#include "bench/bench.hpp"
+#include "synchronization/barrier.hpp"
+#include "synchronization/mutex.hpp"
+#include "synchronization/one_way_barrier.hpp"
+#include "synchronization/shared_mutex.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+
+namespace
+{
+    constexpr uint32_t contention_locks = 200000;
+    constexpr uint32_t contention_critical_work = 32;
+    constexpr uint32_t contention_outside_work = 128;
+    constexpr uint32_t contention_yield_every = 16;
+    constexpr uint32_t read_mostly_operations = 400000;
+    constexpr uint32_t read_mostly_fibers_per_thread = 8;
+    constexpr uint32_t read_mostly_table_size = 64;
+    constexpr uint32_t counter_rounds = 2000;
+    constexpr uint32_t counter_tasks_per_round = 64;
+    constexpr uint32_t barrier_rounds = 1000;
+
+    // Keeps the compiler from folding the busy work away
+    inline uint64_t busy_work(uint64_t value, uint32_t iterations) noexcept
+    {
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            value = value * 6364136223846793005ull + 1442695040888963407ull;
+        }
+
+        return value;
+    }
+
+    // fibers share contention_locks acquisitions of one mutex, on as many workers as there are cores
+    //  Owners now and then yield while holding it, so that waiters pile up even on a single worker
+    void mutex_contention(np::mutex_mode mode, const char* mode_name, uint32_t fibers)
+    {
+        uint16_t threads = np::bench::thread_counts().back();
+        uint64_t shared = 0;
+
+        double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [mode, fibers, &shared](auto& pool) {
+            np::mutex mutex(mode);
+            np::counter counter;
+            for (uint32_t f = 0; f < fibers; ++f)
+            {
+                pool.push([&mutex, &shared, fibers, f] {
+                    uint64_t local = f;
+                    for (uint32_t i = 0; i < contention_locks / fibers; ++i)
+                    {
+                        local = busy_work(local, contention_outside_work);
+
+                        mutex.lock();
+                        shared = busy_work(shared + local, contention_critical_work);
+                        if (i % contention_yield_every == 0)
+                        {
+                            np::this_fiber::yield();
+                        }
+                        mutex.unlock();
+                    }
+                }, counter);
+            }
+
+            counter.wait();
+        });
+
+        std::string variant = std::string(mode_name) + "/" + std::to_string(fibers) + "f";
+        np::bench::report("mutex_contention", variant.c_str(), threads, (contention_locks / fibers) * fibers, seconds);
+    }
+
+    // Fibers look up a shared table and, once every writes_per_thousand operations, update it
+    //  Exclusive mutexes take the lock the same way for both
+    template <typename M>
+    void read_mostly(const char* lock_name, uint32_t writes_per_thousand)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            uint32_t fibers = threads * read_mostly_fibers_per_thread;
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [fibers, writes_per_thousand](auto& pool) {
+                M mutex;
+                std::array<uint64_t, read_mostly_table_size> table{};
+                std::atomic<uint64_t> checksum = 0;
+
+                np::counter counter;
+                for (uint32_t f = 0; f < fibers; ++f)
+                {
+                    pool.push([&, f] {
+                        uint64_t local = f;
+                        for (uint32_t i = 0; i < read_mostly_operations / fibers; ++i)
+                        {
+                            local = busy_work(local, contention_outside_work);
+                            if ((i + f) % 1000 < writes_per_thousand)
+                            {
+                                mutex.lock();
+                                table[local % read_mostly_table_size] = local;
+                                mutex.unlock();
+                                continue;
+                            }
+
+                            if constexpr (std::is_same_v<M, np::shared_mutex>)
+                            {
+                                mutex.lock_shared();
+                                local += busy_work(table[local % read_mostly_table_size], contention_critical_work);
+                                mutex.unlock_shared();
+                            }
+                            else
+                            {
+                                mutex.lock();
+                                local += busy_work(table[local % read_mostly_table_size], contention_critical_work);
+                                mutex.unlock();
+                            }
+                        }
+
+                        checksum.fetch_add(local, std::memory_order_relaxed);
+                    }, counter);
+                }
+
+                counter.wait();
+            });
+
+            std::string variant = std::string(lock_name) + "/" + std::to_string(1000 - writes_per_thousand) + "r";
+            np::bench::report("read_mostly", variant.c_str(), threads, (read_mostly_operations / fibers) * fibers, seconds);
+        }
+    }
+
+    // Every round, counter_tasks_per_round tasks complete on one counter while waiters fibers are blocked on it
+    //  Tasks are held back by a gate until all waiters are queued, which run first as the queues are FIFO
+    void counter_contention(uint32_t waiters)
+    {
+        for (uint16_t threads : np::bench::thread_counts())
+        {
+            double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [waiters](auto& pool) {
+                for (uint32_t round = 0; round < counter_rounds; ++round)
+                {
+                    np::one_way_barrier gate(1);
+                    np::counter tasks;
+                    pool.push_n(counter_tasks_per_round, [&gate](std::size_t) { gate.wait(); }, tasks);
+
+                    np::counter waiting;
+                    for (uint32_t w = 0; w < waiters; ++w)
+                    {
+                        pool.push([&tasks] { tasks.wait(); }, waiting);
+                    }
+
+                    gate.decrease();
+                    waiting.wait();
+                }
+            });
+
+            std::string variant = std::to_string(waiters) + "w";
+            np::bench::report("counter_contention", variant.c_str(), threads, uint64_t(counter_rounds) * (counter_tasks_per_round + waiters), seconds);
+        }
+    }
+
+    // All fibers go through barrier_rounds barriers in lockstep, barriers are single use so there is one per round
+    void barrier_contention(uint32_t fibers)
+    {
+        uint16_t threads = np::bench::thread_counts().back();
+
+        std::vector<std::unique_ptr<np::barrier>> barriers;
+        for (uint32_t round = 0; round < barrier_rounds; ++round)
+        {
+            barriers.push_back(std::make_unique<np::barrier>(fibers));
+        }
+
+        double seconds = np::bench::run_in_pool<np::detail::default_fiber_pool_traits>(threads, [fibers, &barriers](auto& pool) {
+            np::counter counter;
+            for (uint32_t f = 0; f < fibers; ++f)
+            {
+                pool.push([&barriers] {
+                    for (auto& barrier : barriers)
+                    {
+                        barrier->wait();
+                    }
+                }, counter);
+            }
+
+            counter.wait();
+        });
+
+        std::string variant = std::to_string(fibers) + "f";
+        np::bench::report("barrier_contention", variant.c_str(), threads, uint64_t(barrier_rounds) * fibers, seconds);
+    }
+}
+
+NP_BENCHMARK(mutex_contention)
+{
+    for (uint32_t fibers = 2; fibers <= 64; fibers *= 2)
+    {
+        mutex_contention(np::mutex_mode::barging, "barging", fibers);
+        mutex_contention(np::mutex_mode::fair, "fair", fibers);
+    }
+}
+
+// Reads per thousand operations in the variant name, ie. 999r has one write every thousand
+NP_BENCHMARK(read_mostly)
+{
+    for (uint32_t writes_per_thousand : { 0u, 1u, 10u, 100u })
+    {
+        read_mostly<np::shared_mutex>("shared_mutex", writes_per_thousand);
+        read_mostly<np::mutex>("mutex", writes_per_thousand);
+    }
+}
+
+// Waiters per round in the variant name
+NP_BENCHMARK(counter_contention)
+{
+    for (uint32_t waiters : { 1u, 8u, 64u })
+    {
+        counter_contention(waiters);
+    }
+}
+
+NP_BENCHMARK(barrier_contention)
+{
+    for (uint32_t fibers = 2; fibers <= 64; fibers *= 2)
+    {
+        barrier_contention(fibers);
+    }
+}
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "utils/cacheline.hpp"
 
 #include <atomic>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -65,11 +67,12 @@ namespace np
             }
         };
 
-        std::atomic< std::size_t >     top_{ 0 };
-        std::atomic< std::size_t >     bottom_{ 0 };
-        std::atomic< array * >         array_;
+        // Thieves hammer top_ while the owner works on bottom_, keep them on separate lines
+        alignas(detail::cacheline_length) std::atomic< std::size_t >     top_{ 0 };
+        alignas(detail::cacheline_length) std::atomic< std::size_t >     bottom_{ 0 };
+        alignas(detail::cacheline_length) std::atomic< array * >         array_;
         std::vector< array * >                                  old_arrays_{};
-        char                                                    padding_[cacheline_length];
+        char                                                    padding_[detail::cacheline_length];
 
     public:
         spmc_queue( std::size_t capacity = 4096) :
@@ -93,6 +96,13 @@ namespace np
             return bottom <= top;
         }
 
+        // Racy, only meant for statistics
+        std::size_t size_approx() const noexcept {
+            std::size_t bottom = bottom_.load( std::memory_order_relaxed);
+            std::size_t top = top_.load( std::memory_order_relaxed);
+            return bottom > top ? bottom - top : 0;
+        }
+
         void push( T * ctx) {
             std::size_t bottom = bottom_.load( std::memory_order_relaxed);
             std::size_t top = top_.load( std::memory_order_acquire);
@@ -4,24 +4,27 @@
 
 #include <fcontext/fcontext.h>
 
+#include <cassert>
 #include <cstdlib>
 #include <functional>
 
 
+// Heap stacks are only guarded in debug builds (or with NP_GUARD_FIBER_STACK), mapped stacks always are
 #if defined(NP_GUARD_FIBER_STACK) || !defined(NDEBUG)
 #   define NP_DETAIL_USING_FIBER_GUARD_STACK
-#   if !defined(_MSC_VER)
-#		include <sys/mman.h>
-#		include <unistd.h>
-#	else
-#               ifndef WIN32_LEAN_AND_MEAN
-#    		        define WIN32_LEAN_AND_MEAN
-#               endif
-#               ifndef NOMINMAX
-#       		define NOMINMAX
-#               endif
-#		include <Windows.h>
-#	endif
+#endif
+
+#if !defined(_MSC_VER)
+#   include <sys/mman.h>
+#   include <unistd.h>
+#else
+#   ifndef WIN32_LEAN_AND_MEAN
+#       define WIN32_LEAN_AND_MEAN
+#   endif
+#   ifndef NOMINMAX
+#       define NOMINMAX
+#   endif
+#   include <Windows.h>
 #endif
 
 #if !defined(NP_DETAIL_USE_NAKED_CONTEXT) //&& defined(_MSC_VER)
@@ -78,7 +81,6 @@ namespace np
 #endif // _MSC_VER
         }
 
-#if defined(NP_DETAIL_USING_FIBER_GUARD_STACK)
         inline void memory_guard(void* addr, std::size_t len)
         {
 #ifdef _MSC_VER
@@ -98,7 +100,34 @@ namespace np
             mprotect(addr, len, PROT_READ | PROT_WRITE);
 #endif // _MSC_VER
         }
+
+        // Only reserves address space, physical pages come on first touch, nullptr if that fails
+        //  On Windows the range is committed upfront, which only counts against the commit limit
+        inline void* stack_map(std::size_t size) noexcept
+        {
+#ifdef _MSC_VER
+            return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_NORESERVE)
+            flags |= MAP_NORESERVE;
+#endif
+#if defined(MAP_STACK)
+            flags |= MAP_STACK;
 #endif
+            void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+            return addr == MAP_FAILED ? nullptr : addr;
+#endif // _MSC_VER
+        }
+
+        inline void stack_unmap(void* addr, std::size_t size) noexcept
+        {
+#ifdef _MSC_VER
+            VirtualFree(addr, 0, MEM_RELEASE);
+#else
+            munmap(addr, size);
+#endif // _MSC_VER
+        }
 
         template<typename T, typename U> constexpr size_t offset_of(U T::*member)
         {
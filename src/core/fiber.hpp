@@ -25,6 +25,7 @@ namespace np
     {
         static const uint32_t inplace_function_size = 64;
         static const uint32_t stack_size = 524288;
+        using stack_allocator = np::default_stack_allocator;
     };
 
     template <typename traits = default_fiber_traits>
@@ -37,6 +38,10 @@ namespace np
     public:
         using fiber_base::fiber_base;
 
+        // Hide the base constructors that would allocate stacks with the default allocator
+        fiber(std::size_t stack_size, empty_fiber_t) noexcept;
+        fiber(const char* fiber_name, std::size_t stack_size, empty_fiber_t) noexcept;
+
         template <typename F>
         fiber(F&& function) noexcept;
 
@@ -75,6 +80,17 @@ namespace np
     };
 
 
+    template <typename traits>
+    fiber<traits>::fiber(std::size_t stack_size, empty_fiber_t) noexcept :
+        fiber{ "Fibers/%d", stack_size, empty_fiber_t{} }
+    {}
+
+    template <typename traits>
+    fiber<traits>::fiber(const char* fiber_name, std::size_t stack_size, empty_fiber_t) noexcept :
+        fiber_base{ fiber_name, traits::stack_allocator::allocate(stack_size), empty_fiber_t{} },
+        _function()
+    {}
+
     template <typename traits>
     template <typename F>
     fiber<traits>::fiber(F&& function) noexcept :
@@ -96,7 +112,7 @@ namespace np
     template <typename traits>
     template <typename F>
     fiber<traits>::fiber(const char* fiber_name, std::size_t stack_size, F&& function) noexcept :
-        fiber_base{ fiber_name, stack_size, empty_fiber_t{} },
+        fiber_base{ fiber_name, traits::stack_allocator::allocate(stack_size), empty_fiber_t{} },
         _function(std::forward<F>(function))
     {}
 
@@ -129,11 +145,7 @@ namespace np
     {
         _function = std::forward<F>(function);
         _counter = &counter;
-#if defined(NP_DETAIL_USING_FIBER_GUARD_STACK)
-        _ctx = make_fcontext(static_cast<char*>(_stack) + page_size + _stack_size, _stack_size, &detail::builtin_fiber_entrypoint);
-#else
-        _ctx = make_fcontext(static_cast<char*>(_stack) + _stack_size, _stack_size, &detail::builtin_fiber_entrypoint);
-#endif
+        _ctx = make_fcontext(stack_top(), _stack.size, &detail::builtin_fiber_entrypoint);
         _status = fiber_status::initialized;
     }
 
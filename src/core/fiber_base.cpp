@@ -15,11 +15,15 @@ namespace np
         _former_ctx(nullptr),
         _fiber_pool(nullptr),
         _id(current_id++),
-        _stack_size(0),
         _status(fiber_status::uninitialized),
         _execution_status(fiber_execution_status::ready),
+        _stack_class(0),
+        _priority(np::priority::normal),
+        _worker(detail::unpinned),
         _counter(&detail::dummy_counter),
-        _stack(nullptr)
+        _stack(),
+        _site(nullptr),
+        _pushed_at()
     {
         plDeclareVirtualThread(_id, fiber_name, _id);
     }
@@ -37,38 +41,35 @@ namespace np
     {}
 
     fiber_base::fiber_base(const char* fiber_name, std::size_t stack_size, empty_fiber_t) noexcept :
+        fiber_base{ fiber_name, np::default_stack_allocator::allocate(stack_size), {} }
+    {}
+
+    fiber_base::fiber_base(const char* fiber_name, np::stack_context stack, empty_fiber_t) noexcept :
         _ctx(),
         _former_ctx(nullptr),
         _fiber_pool(nullptr),
         _id(current_id++),
-        _stack_size(stack_size),
         _status(fiber_status::initialized),
         _execution_status(fiber_execution_status::ready),
-        _counter(&detail::dummy_counter)
+        _stack_class(0),
+        _priority(np::priority::normal),
+        _worker(detail::unpinned),
+        _counter(&detail::dummy_counter),
+        _stack(stack),
+        _site(nullptr),
+        _pushed_at()
     {
         plDeclareVirtualThread(_id, fiber_name, _id);
-
-        #if defined(NP_DETAIL_USING_FIBER_GUARD_STACK)
-            _stack_size = detail::round_up(stack_size, page_size);
-            _stack = detail::aligned_malloc(page_size + _stack_size + page_size, page_size);
-            _ctx = make_fcontext(static_cast<char*>(_stack) + page_size + _stack_size, _stack_size, &detail::builtin_fiber_entrypoint);
-        
-            detail::memory_guard(_stack, page_size);
-            detail::memory_guard(static_cast<char*>(_stack) + page_size + _stack_size, page_size);
-        #else
-            _stack = detail::aligned_malloc(_stack_size, sizeof(uintptr_t));
-            _ctx = make_fcontext(static_cast<char*>(_stack) + _stack_size, _stack_size, &detail::builtin_fiber_entrypoint);
-        #endif
+        _ctx = make_fcontext(stack_top(), _stack.size, &detail::builtin_fiber_entrypoint);
     }
 
     fiber_base::~fiber_base() noexcept
     {
-        #if defined(NP_DETAIL_USING_FIBER_GUARD_STACK)
-            detail::memory_guard_release(_stack, page_size);
-            detail::memory_guard_release(static_cast<char*>(_stack) + page_size + _stack_size, page_size);
-        #endif
-
-        detail::aligned_free(_stack);        
+        // Moved-from fibers have no stack
+        if (_stack.deallocate)
+        {
+            _stack.deallocate(_stack);
+        }
     }
 
     fiber_base::fiber_base(fiber_base&& other) noexcept :
@@ -78,11 +79,15 @@ namespace np
         std::swap(_former_ctx, other._former_ctx);
         std::swap(_fiber_pool, other._fiber_pool);
         std::swap(_id, other._id);
-        std::swap(_stack_size, other._stack_size);
         std::swap(_status, other._status);
         _execution_status = other._execution_status.load(std::memory_order_release); // TODO(gpascualg): Mem order
+        std::swap(_stack_class, other._stack_class);
+        std::swap(_priority, other._priority);
+        std::swap(_worker, other._worker);
         std::swap(_counter, other._counter);
         std::swap(_stack, other._stack);
+        std::swap(_site, other._site);
+        std::swap(_pushed_at, other._pushed_at);
     }
 
     fiber_base& fiber_base::operator=(fiber_base&& other) noexcept
@@ -91,11 +96,15 @@ namespace np
         std::swap(_former_ctx, other._former_ctx);
         std::swap(_fiber_pool, other._fiber_pool);
         std::swap(_id, other._id);
-        std::swap(_stack_size, other._stack_size);
         std::swap(_status, other._status);
         _execution_status = other._execution_status.load(std::memory_order_release); // TODO(gpascualg): Mem order
+        std::swap(_stack_class, other._stack_class);
+        std::swap(_priority, other._priority);
+        std::swap(_worker, other._worker);
         std::swap(_counter, other._counter);
         std::swap(_stack, other._stack);
+        std::swap(_site, other._site);
+        std::swap(_pushed_at, other._pushed_at);
 
         return *this;
     }
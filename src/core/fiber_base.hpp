@@ -1,12 +1,14 @@
 #pragma once
 
 #include "core/detail/fiber.hpp"
+#include "core/stack_allocator.hpp"
 #include "synchronization/counter.hpp"
 #include "utils/badge.hpp"
 
 #include <fcontext/fcontext.h>
 
 #include <cassert>
+#include <chrono>
 #include <inttypes.h>
 
 
@@ -16,6 +18,8 @@ namespace np
     {
         inline fcontext_transfer_t builtin_fiber_resume(fcontext_transfer_t transfer) noexcept;
         inline fcontext_transfer_t builtin_fiber_yield(fcontext_transfer_t transfer) noexcept;
+
+        struct stack_site;
     }
 
 
@@ -38,6 +42,22 @@ namespace np
         ready
     };
 
+    // Dispatchers run higher priorities first, see the pool traits' yield_priority for how lower ones avoid starving
+    enum class priority : uint8_t
+    {
+        high,
+        normal,
+        low
+    };
+
+    namespace detail
+    {
+        inline constexpr std::size_t number_of_priorities = 3;
+
+        // Worker of fibers free to run anywhere, pools never hand out the last worker id
+        inline constexpr uint8_t unpinned = 255;
+    }
+
 
     class fiber_base
     {
@@ -57,6 +77,7 @@ namespace np
         fiber_base(std::size_t stack_size, empty_fiber_t) noexcept;
         fiber_base(const char* fiber_name, empty_fiber_t) noexcept;
         fiber_base(const char* fiber_name, std::size_t stack_size, empty_fiber_t) noexcept;
+        fiber_base(const char* fiber_name, np::stack_context stack, empty_fiber_t) noexcept;
 
         fiber_base(const fiber_base&) = delete;
         fiber_base& operator=(const fiber_base&) = delete;
@@ -69,6 +90,9 @@ namespace np
 
         inline fiber_pool_base* get_fiber_pool() const noexcept;
         inline uint32_t id() const noexcept;
+
+        // Memory the fiber runs on
+        inline const np::stack_context& stack() const noexcept;
         inline void execution_status(::badge<fiber_pool_base>, fiber_execution_status status) noexcept;
         inline fiber_execution_status execution_status(::badge<fiber_pool_base>) noexcept;
 
@@ -83,6 +107,9 @@ namespace np
     protected:
         void yield_blocking(fiber_base* to) noexcept;
 
+        // Highest address of the usable stack, where contexts are created
+        inline void* stack_top() const noexcept;
+
         inline constexpr auto badge()
         {
             return ::badge<fiber_base>{};
@@ -100,13 +127,21 @@ namespace np
 
         // Fiber information
         uint32_t _id;
-        std::size_t _stack_size;
         fiber_status _status;
         std::atomic<fiber_execution_status> _execution_status;
+        uint8_t _stack_class;
+        np::priority _priority;
+        uint8_t _worker;
 
         // Execution information
         np::counter* _counter;
-        void* _stack;
+        np::stack_context _stack;
+
+        // Only set by pools that profile stacks
+        const detail::stack_site* _site;
+
+        // Only set for tasks sampled for wait times
+        std::chrono::steady_clock::time_point _pushed_at;
     };
 
 
@@ -142,6 +177,16 @@ namespace np
         return _execution_status.load(std::memory_order_acquire);
     }
 
+    inline const np::stack_context& fiber_base::stack() const noexcept
+    {
+        return _stack;
+    }
+
+    inline void* fiber_base::stack_top() const noexcept
+    {
+        return _stack.top;
+    }
+
     inline fiber_base& fiber_base::resume(fiber_base* fiber) noexcept
     {
         return resume(nullptr, fiber);
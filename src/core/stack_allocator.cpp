@@ -0,0 +1,104 @@
+#include "core/stack_allocator.hpp"
+#include "core/detail/fiber.hpp"
+
+#include <cstdlib>
+
+#include <spdlog/spdlog.h>
+
+
+namespace np
+{
+    namespace
+    {
+        // Fibers can't run without a stack, and every caller expects one
+        //  Running out of mappings (vm.max_map_count) is the usual culprit with mapped stacks
+        void ensure_allocated(const stack_context& stack) noexcept
+        {
+            if (!stack.allocation)
+            {
+                spdlog::critical("Could not allocate a fiber stack of {} bytes", stack.allocation_size);
+                std::abort();
+            }
+        }
+    }
+
+    stack_context heap_stack_allocator::allocate(std::size_t size) noexcept
+    {
+        stack_context stack;
+        stack.deallocate = &heap_stack_allocator::deallocate;
+
+#if defined(NP_DETAIL_USING_FIBER_GUARD_STACK)
+        static const std::size_t page_size = detail::page_size();
+
+        stack.size = detail::round_up(size, page_size);
+        stack.allocation_size = page_size + stack.size + page_size;
+        stack.allocation = detail::aligned_malloc(stack.allocation_size, page_size);
+        ensure_allocated(stack);
+        stack.top = static_cast<char*>(stack.allocation) + page_size + stack.size;
+
+        detail::memory_guard(stack.allocation, page_size);
+        detail::memory_guard(stack.top, page_size);
+#else
+        stack.size = size;
+        stack.allocation_size = size;
+        stack.allocation = detail::aligned_malloc(stack.allocation_size, sizeof(uintptr_t));
+        ensure_allocated(stack);
+        stack.top = static_cast<char*>(stack.allocation) + stack.size;
+#endif
+
+        return stack;
+    }
+
+    void heap_stack_allocator::deallocate(stack_context& stack) noexcept
+    {
+#if defined(NP_DETAIL_USING_FIBER_GUARD_STACK)
+        static const std::size_t page_size = detail::page_size();
+
+        detail::memory_guard_release(stack.allocation, page_size);
+        detail::memory_guard_release(stack.top, page_size);
+#endif
+
+        detail::aligned_free(stack.allocation);
+        stack = {};
+    }
+
+    stack_context mapped_stack_allocator::allocate(std::size_t size) noexcept
+    {
+        static const std::size_t page_size = detail::page_size();
+
+        stack_context stack;
+        stack.deallocate = &mapped_stack_allocator::deallocate;
+        stack.size = detail::round_up(size, page_size);
+        stack.allocation_size = page_size + stack.size;
+        stack.allocation = detail::stack_map(stack.allocation_size);
+        ensure_allocated(stack);
+        stack.top = static_cast<char*>(stack.allocation) + stack.allocation_size;
+
+        detail::memory_guard(stack.allocation, page_size);
+        return stack;
+    }
+
+    void mapped_stack_allocator::deallocate(stack_context& stack) noexcept
+    {
+        detail::stack_unmap(stack.allocation, stack.allocation_size);
+        stack = {};
+    }
+
+    namespace detail
+    {
+        void prefault_stack(const stack_context& stack) noexcept
+        {
+            static const std::size_t page_size = detail::page_size();
+
+            // Writing is what commits a page, reading untouched memory may only map the shared zero page
+            //  The context at the top is already there, write back whatever each byte holds
+            volatile char* top = static_cast<char*>(stack.top);
+            for (std::size_t offset = 1; offset <= stack.size; offset += page_size)
+            {
+                top[-std::ptrdiff_t(offset)] = top[-std::ptrdiff_t(offset)];
+            }
+
+            top[-std::ptrdiff_t(stack.size)] = top[-std::ptrdiff_t(stack.size)];
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace np
+{
+    // Memory backing a fiber stack, as handed out by a stack allocator
+    struct stack_context
+    {
+        void* allocation;
+        std::size_t allocation_size;
+
+        // Stacks grow downwards, contexts are created at top and may use size bytes below it
+        void* top;
+        std::size_t size;
+
+        void(*deallocate)(stack_context& stack) noexcept;
+    };
+
+    // Plain heap memory, guarded on both ends in debug builds (or with NP_GUARD_FIBER_STACK)
+    class heap_stack_allocator
+    {
+    public:
+        static stack_context allocate(std::size_t size) noexcept;
+        static void deallocate(stack_context& stack) noexcept;
+    };
+
+    // Address space straight from the OS, pages are only committed once touched and a guard page
+    //  always sits right below the stack
+    class mapped_stack_allocator
+    {
+    public:
+        static stack_context allocate(std::size_t size) noexcept;
+        static void deallocate(stack_context& stack) noexcept;
+    };
+
+    namespace detail
+    {
+        // Commits every page of the stack from the calling thread, and so on its node, instead of leaving
+        //  each one to whoever first runs that deep. Contents are left untouched
+        void prefault_stack(const stack_context& stack) noexcept;
+    }
+
+#if defined(NP_FIBER_STACK_MALLOC)
+    using default_stack_allocator = heap_stack_allocator;
+#else
+    using default_stack_allocator = mapped_stack_allocator;
+#endif
+}
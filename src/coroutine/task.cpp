@@ -0,0 +1,35 @@
+#include "coroutine/task.hpp"
+#include "pool/fiber_pool.hpp"
+
+
+namespace np
+{
+    namespace detail
+    {
+        std::coroutine_handle<> task_promise_base::finish(std::coroutine_handle<> coroutine) noexcept
+        {
+            if (_continuation)
+            {
+                return _continuation;
+            }
+
+            // Spawned, nobody holds it anymore. Waiters on the counter may tear down whatever the frame pointed at
+            if (_counter)
+            {
+                np::counter* counter = _counter;
+                fiber_pool_base* fiber_pool = _fiber_pool;
+                coroutine.destroy();
+                counter->done_impl(fiber_pool);
+            }
+
+            return std::noop_coroutine();
+        }
+
+        void yield_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+        {
+            fiber_pool_base* fiber_pool = fiber_pool_base::running_pool();
+            assert(fiber_pool && "Tasks can only yield while run by a fiber pool");
+            fiber_pool->resume({}, coroutine);
+        }
+    }
+}
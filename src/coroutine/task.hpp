@@ -0,0 +1,229 @@
+#pragma once
+
+#include "utils/badge.hpp"
+
+#include <coroutine>
+#include <cstdlib>
+#include <optional>
+#include <utility>
+
+
+namespace np
+{
+    class counter;
+    class fiber_pool_base;
+
+    template <typename T = void>
+    class task;
+
+    namespace detail
+    {
+        // Everything but the result, which depends on the task's type
+        class task_promise_base
+        {
+        public:
+            struct final_awaiter
+            {
+                bool await_ready() noexcept { return false; }
+                void await_resume() noexcept {}
+
+                template <typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> coroutine) noexcept
+                {
+                    return static_cast<task_promise_base&>(coroutine.promise()).finish(coroutine);
+                }
+            };
+
+            // Tasks are lazy, they only start once awaited or spawned
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            final_awaiter final_suspend() noexcept { return {}; }
+
+            // Like everything else in the library, tasks don't throw
+            void unhandled_exception() noexcept { std::abort(); }
+
+            inline void continuation(std::coroutine_handle<> coroutine) noexcept;
+            inline void detach(::badge<fiber_pool_base>, fiber_pool_base* fiber_pool, np::counter* counter) noexcept;
+
+        private:
+            // Awaited tasks go on with whoever awaits them, spawned ones are destroyed and complete their counter
+            std::coroutine_handle<> finish(std::coroutine_handle<> coroutine) noexcept;
+
+        private:
+            std::coroutine_handle<> _continuation;
+            fiber_pool_base* _fiber_pool = nullptr;
+            np::counter* _counter = nullptr;
+        };
+
+        template <typename T>
+        class task_promise : public task_promise_base
+        {
+        public:
+            inline task<T> get_return_object() noexcept;
+
+            template <typename U>
+            void return_value(U&& value) noexcept
+            {
+                _value.emplace(std::forward<U>(value));
+            }
+
+            T result() noexcept
+            {
+                return std::move(*_value);
+            }
+
+        private:
+            std::optional<T> _value;
+        };
+
+        template <>
+        class task_promise<void> : public task_promise_base
+        {
+        public:
+            inline task<void> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+            void result() noexcept {}
+        };
+
+        struct yield_awaiter
+        {
+            bool await_ready() noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> coroutine) noexcept;
+            void await_resume() noexcept {}
+        };
+    }
+
+    // Stackless counterpart of a fiber, its frame is all it needs while suspended
+    //  Tasks run on the dispatchers of the pool they are spawned in, taking turns with fibers. Nothing in them may
+    //  block the thread, waits on synchronization primitives go through their *_async awaitables instead, which
+    //  mutex, shared_mutex, condition_variable, counting_semaphore, counter and one_way_barrier have. Neither
+    //  np::event nor np::barrier can be waited on from tasks
+    template <typename T>
+    class task
+    {
+    public:
+        using promise_type = detail::task_promise<T>;
+
+        class awaiter
+        {
+        public:
+            explicit awaiter(std::coroutine_handle<promise_type> coroutine) noexcept :
+                _coroutine(coroutine)
+            {}
+
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                _coroutine.promise().continuation(awaiting);
+                return _coroutine;
+            }
+
+            T await_resume() noexcept
+            {
+                return _coroutine.promise().result();
+            }
+
+        private:
+            std::coroutine_handle<promise_type> _coroutine;
+        };
+
+    public:
+        explicit task(std::coroutine_handle<promise_type> coroutine) noexcept;
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+
+        task(task&& other) noexcept;
+        task& operator=(task&& other) noexcept;
+
+        ~task() noexcept;
+
+        // Awaited tasks run right away on the awaiting coroutine's worker, which goes on once they return
+        inline awaiter operator co_await() && noexcept;
+
+        // Whoever runs it owns it from then on, ie. pools spawning it
+        inline std::coroutine_handle<promise_type> release(::badge<fiber_pool_base>) noexcept;
+
+    private:
+        std::coroutine_handle<promise_type> _coroutine;
+    };
+
+    namespace this_task
+    {
+        // Lets other tasks and fibers run, the calling task goes to the back of its pool's queue
+        inline detail::yield_awaiter yield() noexcept
+        {
+            return {};
+        }
+    }
+
+
+    namespace detail
+    {
+        inline void task_promise_base::continuation(std::coroutine_handle<> coroutine) noexcept
+        {
+            _continuation = coroutine;
+        }
+
+        inline void task_promise_base::detach(::badge<fiber_pool_base>, fiber_pool_base* fiber_pool, np::counter* counter) noexcept
+        {
+            _fiber_pool = fiber_pool;
+            _counter = counter;
+        }
+
+        template <typename T>
+        inline task<T> task_promise<T>::get_return_object() noexcept
+        {
+            return task<T>{ std::coroutine_handle<task_promise<T>>::from_promise(*this) };
+        }
+
+        inline task<void> task_promise<void>::get_return_object() noexcept
+        {
+            return task<void>{ std::coroutine_handle<task_promise<void>>::from_promise(*this) };
+        }
+    }
+
+    template <typename T>
+    task<T>::task(std::coroutine_handle<promise_type> coroutine) noexcept :
+        _coroutine(coroutine)
+    {}
+
+    template <typename T>
+    task<T>::task(task&& other) noexcept :
+        _coroutine(std::exchange(other._coroutine, nullptr))
+    {}
+
+    template <typename T>
+    task<T>& task<T>::operator=(task&& other) noexcept
+    {
+        if (_coroutine)
+        {
+            _coroutine.destroy();
+        }
+
+        _coroutine = std::exchange(other._coroutine, nullptr);
+        return *this;
+    }
+
+    template <typename T>
+    task<T>::~task() noexcept
+    {
+        if (_coroutine)
+        {
+            _coroutine.destroy();
+        }
+    }
+
+    template <typename T>
+    inline typename task<T>::awaiter task<T>::operator co_await() && noexcept
+    {
+        return awaiter{ _coroutine };
+    }
+
+    template <typename T>
+    inline std::coroutine_handle<typename task<T>::promise_type> task<T>::release(::badge<fiber_pool_base>) noexcept
+    {
+        return std::exchange(_coroutine, nullptr);
+    }
+}
@@ -3,6 +3,8 @@
 #include "synchronization/event.hpp"
 #include "synchronization/mutex.hpp"
 
+#include <concurrentqueue.h>
+
 
 namespace np
 {
@@ -15,8 +17,8 @@ namespace np
 		void push(T&& value) noexcept;
 		void push_blocking(T&& value) noexcept;
 
-		bool pop(T&& value) noexcept;
-		void pop_blocking(T&& value) noexcept;
+		bool pop(T& value) noexcept;
+		void pop_blocking(T& value) noexcept;
 
 	private:
 		np::event _ev;
@@ -52,13 +54,13 @@ namespace np
 	}
 
 	template <typename T>
-	bool channel<T>::pop(T&& value) noexcept
+	bool channel<T>::pop(T& value) noexcept
 	{
-		return _queue.try_dequeue(std::forward<T>(value));
+		return _queue.try_dequeue(value);
 	}
 
 	template <typename T>
-	void channel<T>::pop_blocking(T&& value) noexcept
+	void channel<T>::pop_blocking(T& value) noexcept
 	{
 		// Wait until there is some work
 		_mutex.lock();
@@ -71,7 +73,7 @@ namespace np
 		--_pending;
 		_mutex.unlock();
 
-		// Pop jobs
-		return _queue.try_dequeue(std::forward<T>(value));
+		// Pushes are queued before _pending is increased, so there is always one to take
+		_queue.try_dequeue(value);
 	}
 }
@@ -3,6 +3,8 @@
 #include "synchronization/condition_variable.hpp"
 #include "synchronization/mutex.hpp"
 
+#include <concurrentqueue.h>
+
 #include <functional>
 #include <inplace_function.h>
 
@@ -0,0 +1,140 @@
+#include "io/epoll_reactor.hpp"
+#include "pool/fiber_pool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+namespace np::io
+{
+    epoll_reactor* epoll_reactor::create() noexcept
+    {
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+        {
+            return nullptr;
+        }
+
+        int wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wake_fd < 0)
+        {
+            close(epoll_fd);
+            return nullptr;
+        }
+
+        // Level triggered, the reactor drains it whenever it shows up
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+        return new epoll_reactor(epoll_fd, wake_fd);
+    }
+
+    epoll_reactor::epoll_reactor(int epoll_fd, int wake_fd) noexcept :
+        reactor(wake_fd),
+        _epoll_fd(epoll_fd)
+    {}
+
+    epoll_reactor::~epoll_reactor() noexcept
+    {
+        close(_epoll_fd);
+        close(_wake_fd);
+    }
+
+    int64_t epoll_reactor::execute(operation& operation) noexcept
+    {
+        if (operation.code == opcode::fsync)
+        {
+            return reactor::perform(operation);
+        }
+
+        const uint32_t events = (operation.code == opcode::write || operation.code == opcode::send || operation.code == opcode::connect) ? EPOLLOUT : EPOLLIN;
+
+        // Nonblocking sockets may still fail with EAGAIN after a spurious wake up, blocking descriptors won't
+        //  block once ready. Connects on nonblocking sockets are started first and then waited for
+        if (operation.code == opcode::connect)
+        {
+            int64_t result = reactor::perform(operation);
+            if (result != -EINPROGRESS || !wait_ready(operation, events))
+            {
+                return result;
+            }
+
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(operation.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            return -error;
+        }
+
+        while (true)
+        {
+            const bool polled = wait_ready(operation, events);
+            int64_t result = reactor::perform(operation);
+            if (!polled || (result != -EAGAIN && result != -EWOULDBLOCK))
+            {
+                return result;
+            }
+        }
+    }
+
+    void epoll_reactor::poll(fiber_pool_base* fiber_pool) noexcept
+    {
+        reap(fiber_pool, 0);
+    }
+
+    void epoll_reactor::wait(fiber_pool_base* fiber_pool, const clock::time_point* deadline) noexcept
+    {
+        int timeout = -1;
+        if (deadline)
+        {
+            auto remaining = std::max(clock::duration::zero(), *deadline - clock::now());
+            timeout = int(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+        }
+
+        reap(fiber_pool, timeout);
+    }
+
+    bool epoll_reactor::wait_ready(operation& operation, uint32_t events) noexcept
+    {
+        epoll_event event{};
+        event.events = events | EPOLLONESHOT;
+        event.data.ptr = &operation;
+
+        if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, operation.fd, &event) != 0)
+        {
+            // Left behind by a previous wait on the same descriptor
+            if (errno != EEXIST || epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, operation.fd, &event) != 0)
+            {
+                return false;
+            }
+        }
+
+        ++_pending;
+        block(operation);
+        return true;
+    }
+
+    void epoll_reactor::reap(fiber_pool_base* fiber_pool, int timeout) noexcept
+    {
+        epoll_event events[maximum_events];
+        int count = epoll_wait(_epoll_fd, events, maximum_events, timeout);
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (!events[i].data.ptr)
+            {
+                uint64_t value;
+                [[maybe_unused]] auto read = ::read(_wake_fd, &value, sizeof(value));
+                continue;
+            }
+
+            --_pending;
+            complete(fiber_pool, *static_cast<operation*>(events[i].data.ptr), int64_t(events[i].events));
+        }
+    }
+}
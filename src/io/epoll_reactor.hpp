@@ -0,0 +1,34 @@
+#pragma once
+
+#include "io/reactor.hpp"
+
+
+namespace np::io
+{
+    // Readiness based fallback, fibers wait until their descriptor is ready and then do the syscall
+    //  themselves. Regular files can't be polled and fsync is never asynchronous, both run inline
+    //  Only one fiber at a time may wait on a given descriptor
+    class epoll_reactor final : public reactor
+    {
+    public:
+        static epoll_reactor* create() noexcept;
+
+        ~epoll_reactor() noexcept override;
+
+        int64_t execute(operation& operation) noexcept override;
+        void poll(fiber_pool_base* fiber_pool) noexcept override;
+        void wait(fiber_pool_base* fiber_pool, const clock::time_point* deadline) noexcept override;
+
+    private:
+        epoll_reactor(int epoll_fd, int wake_fd) noexcept;
+
+        // False if the descriptor can't be polled, in which case it is always considered ready
+        bool wait_ready(operation& operation, uint32_t events) noexcept;
+        void reap(fiber_pool_base* fiber_pool, int timeout) noexcept;
+
+    private:
+        static constexpr int maximum_events = 64;
+
+        int _epoll_fd;
+    };
+}
@@ -0,0 +1,54 @@
+#include "io/io.hpp"
+#include "io/reactor.hpp"
+
+
+namespace np::io
+{
+    namespace
+    {
+        int64_t execute(operation&& operation) noexcept
+        {
+            if (auto current = reactor::current())
+            {
+                return current->execute(operation);
+            }
+
+            return reactor::perform(operation);
+        }
+    }
+
+    ssize_t read(int fd, void* buffer, std::size_t size, int64_t offset) noexcept
+    {
+        return ssize_t(execute({ .code = opcode::read, .fd = fd, .buffer = buffer, .size = size, .offset = offset }));
+    }
+
+    ssize_t write(int fd, const void* buffer, std::size_t size, int64_t offset) noexcept
+    {
+        return ssize_t(execute({ .code = opcode::write, .fd = fd, .buffer = const_cast<void*>(buffer), .size = size, .offset = offset }));
+    }
+
+    ssize_t recv(int fd, void* buffer, std::size_t size, int flags) noexcept
+    {
+        return ssize_t(execute({ .code = opcode::recv, .fd = fd, .buffer = buffer, .size = size, .flags = flags }));
+    }
+
+    ssize_t send(int fd, const void* buffer, std::size_t size, int flags) noexcept
+    {
+        return ssize_t(execute({ .code = opcode::send, .fd = fd, .buffer = const_cast<void*>(buffer), .size = size, .flags = flags }));
+    }
+
+    int accept(int fd, sockaddr* address, socklen_t* address_length, int flags) noexcept
+    {
+        return int(execute({ .code = opcode::accept, .fd = fd, .flags = flags, .address = address, .address_length = address_length }));
+    }
+
+    int connect(int fd, const sockaddr* address, socklen_t address_length) noexcept
+    {
+        return int(execute({ .code = opcode::connect, .fd = fd, .address = const_cast<sockaddr*>(address), .address_length = &address_length }));
+    }
+
+    int fsync(int fd, bool datasync) noexcept
+    {
+        return int(execute({ .code = opcode::fsync, .fd = fd, .flags = datasync ? fsync_datasync : 0 }));
+    }
+}
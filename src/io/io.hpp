@@ -0,0 +1,29 @@
+#pragma once
+
+#include "io/reactor.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+
+// Asynchronous I/O for fibers, the calling fiber blocks while its worker keeps running others
+//  Results follow io_uring: >= 0 on success and -errno on failure
+//  Outside of fiber pools the plain syscall is done instead, blocking the calling thread
+namespace np::io
+{
+    // A negative offset uses (and advances) the file position
+    ssize_t read(int fd, void* buffer, std::size_t size, int64_t offset = -1) noexcept;
+    ssize_t write(int fd, const void* buffer, std::size_t size, int64_t offset = -1) noexcept;
+
+    ssize_t recv(int fd, void* buffer, std::size_t size, int flags = 0) noexcept;
+    ssize_t send(int fd, const void* buffer, std::size_t size, int flags = 0) noexcept;
+
+    // Returns the accepted descriptor, flags as in accept4
+    int accept(int fd, sockaddr* address = nullptr, socklen_t* address_length = nullptr, int flags = 0) noexcept;
+    int connect(int fd, const sockaddr* address, socklen_t address_length) noexcept;
+
+    int fsync(int fd, bool datasync = false) noexcept;
+}
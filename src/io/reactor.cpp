@@ -0,0 +1,100 @@
+#include "io/reactor.hpp"
+#include "io/epoll_reactor.hpp"
+#include "io/uring_reactor.hpp"
+#include "pool/fiber_pool.hpp"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+
+namespace np::io
+{
+    reactor* reactor::create() noexcept
+    {
+        if (auto reactor = uring_reactor::create())
+        {
+            return reactor;
+        }
+
+        return epoll_reactor::create();
+    }
+
+    reactor* reactor::current() noexcept
+    {
+        return fiber_pool_base::this_reactor({});
+    }
+
+    int64_t reactor::perform(operation& operation) noexcept
+    {
+        int64_t result = -1;
+        switch (operation.code)
+        {
+            case opcode::read:
+                result = operation.offset < 0 ?
+                    ::read(operation.fd, operation.buffer, operation.size) :
+                    ::pread(operation.fd, operation.buffer, operation.size, operation.offset);
+                break;
+
+            case opcode::write:
+                result = operation.offset < 0 ?
+                    ::write(operation.fd, operation.buffer, operation.size) :
+                    ::pwrite(operation.fd, operation.buffer, operation.size, operation.offset);
+                break;
+
+            case opcode::recv:
+                result = ::recv(operation.fd, operation.buffer, operation.size, operation.flags);
+                break;
+
+            case opcode::send:
+                result = ::send(operation.fd, operation.buffer, operation.size, operation.flags);
+                break;
+
+            case opcode::accept:
+                result = ::accept4(operation.fd, operation.address, operation.address_length, operation.flags);
+                break;
+
+            case opcode::connect:
+                result = ::connect(operation.fd, operation.address, *operation.address_length);
+                break;
+
+            case opcode::fsync:
+                result = (operation.flags & fsync_datasync) ? ::fdatasync(operation.fd) : ::fsync(operation.fd);
+                break;
+        }
+
+        return result < 0 ? -errno : result;
+    }
+
+    reactor::reactor(int wake_fd) noexcept :
+        _wake_fd(wake_fd),
+        _pending(0),
+        _sleeping(false)
+    {}
+
+    bool reactor::wake() noexcept
+    {
+        if (!_sleeping.exchange(false, std::memory_order_seq_cst))
+        {
+            return false;
+        }
+
+        uint64_t value = 1;
+        [[maybe_unused]] auto written = ::write(_wake_fd, &value, sizeof(value));
+        return true;
+    }
+
+    void reactor::complete(fiber_pool_base* fiber_pool, operation& operation, int64_t result) noexcept
+    {
+        // The fiber may resume right away and take the operation with it
+        np::fiber_base* fiber = operation.fiber;
+        operation.result = result;
+        fiber_pool->unblock({}, fiber);
+    }
+
+    void reactor::block(operation& operation) noexcept
+    {
+        operation.fiber = this_fiber::instance();
+        operation.fiber->get_fiber_pool()->block({});
+    }
+}
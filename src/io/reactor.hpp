@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+
+namespace np
+{
+    class fiber_base;
+    class fiber_pool_base;
+}
+
+namespace np::io
+{
+    enum class opcode : uint8_t
+    {
+        read,
+        write,
+        recv,
+        send,
+        accept,
+        connect,
+        fsync
+    };
+
+    // Flags for opcode::fsync
+    inline constexpr int fsync_datasync = 1;
+
+    // A single request, it lives on the stack of the fiber that waits for it
+    struct operation
+    {
+        opcode code;
+        int fd;
+        void* buffer;
+        std::size_t size;
+        int64_t offset;
+        int flags;
+        sockaddr* address;
+        socklen_t* address_length;
+
+        np::fiber_base* fiber;
+        int64_t result;
+    };
+
+    // Per worker completion queue, only ever touched from the thread of that worker except for wake
+    //  Fibers submit and block, and the dispatcher of the same worker reaps completions and unblocks them
+    class reactor
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // io_uring if the kernel supports it, epoll otherwise, or null if none could be created
+        static reactor* create() noexcept;
+
+        // The reactor of the calling fiber's worker, or null outside of fiber pools
+        static reactor* current() noexcept;
+
+        // Runs the syscall right away, blocking the calling thread
+        static int64_t perform(operation& operation) noexcept;
+
+        virtual ~reactor() noexcept = default;
+
+        // Blocks the calling fiber until the operation is done, results are either >= 0 or -errno
+        virtual int64_t execute(operation& operation) noexcept = 0;
+
+        // Submits pending work and unblocks the owners of whatever completed, without waiting
+        virtual void poll(fiber_pool_base* fiber_pool) noexcept = 0;
+
+        // Same as poll but sleeps in the kernel until a completion, a wake or the deadline
+        virtual void wait(fiber_pool_base* fiber_pool, const clock::time_point* deadline) noexcept = 0;
+
+        // Operations still in flight
+        inline uint32_t pending() const noexcept;
+
+        // Idle dispatchers announce they are sleeping in wait, so that notifiers know whom to wake
+        inline void sleeping(bool sleeping) noexcept;
+        bool wake() noexcept;
+
+    protected:
+        reactor(int wake_fd) noexcept;
+
+        static void complete(fiber_pool_base* fiber_pool, operation& operation, int64_t result) noexcept;
+        static void block(operation& operation) noexcept;
+
+    protected:
+        int _wake_fd;
+        uint32_t _pending;
+        std::atomic<bool> _sleeping;
+    };
+
+
+    inline uint32_t reactor::pending() const noexcept
+    {
+        return _pending;
+    }
+
+    inline void reactor::sleeping(bool sleeping) noexcept
+    {
+        _sleeping.store(sleeping, std::memory_order_seq_cst);
+    }
+}
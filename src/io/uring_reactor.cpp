@@ -0,0 +1,306 @@
+#include "io/uring_reactor.hpp"
+#include "pool/fiber_pool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace np::io
+{
+    namespace
+    {
+        // Completions with this user data belong to the wake eventfd read, operations are never null
+        constexpr uint64_t wake_user_data = 0;
+
+        template <typename T>
+        inline T* ring_field(void* ring, uint32_t offset) noexcept
+        {
+            return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+        }
+
+        inline uint32_t load_acquire(const uint32_t* value) noexcept
+        {
+            return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+        }
+
+        inline void store_release(uint32_t* value, uint32_t desired) noexcept
+        {
+            __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+        }
+    }
+
+    uring_reactor* uring_reactor::create() noexcept
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        int ring_fd = int(syscall(__NR_io_uring_setup, ring_entries, &params));
+        if (ring_fd < 0)
+        {
+            return nullptr;
+        }
+
+        int wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if ((params.features & IORING_FEAT_EXT_ARG) == 0 || wake_fd < 0)
+        {
+            if (wake_fd >= 0)
+            {
+                close(wake_fd);
+            }
+
+            close(ring_fd);
+            return nullptr;
+        }
+
+        auto reactor = new uring_reactor(ring_fd, wake_fd, params);
+        if (!reactor->mapped())
+        {
+            delete reactor;
+            return nullptr;
+        }
+
+        reactor->arm_wake();
+        return reactor;
+    }
+
+    uring_reactor::uring_reactor(int ring_fd, int wake_fd, const io_uring_params& params) noexcept :
+        reactor(wake_fd),
+        _ring_fd(ring_fd),
+        _unsubmitted(0),
+        _wake_value(0),
+        _wake_armed(false),
+        _sq_ring(MAP_FAILED),
+        _sq_ring_size(params.sq_off.array + params.sq_entries * sizeof(uint32_t)),
+        _cq_ring(MAP_FAILED),
+        _cq_ring_size(params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)),
+        _sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+        _sqes_size(params.sq_entries * sizeof(io_uring_sqe))
+    {
+        // Newer kernels map both rings at once
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            _sq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+            _cq_ring_size = _sq_ring_size;
+        }
+
+        _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED)
+        {
+            return;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            _cq_ring = _sq_ring;
+        }
+        else
+        {
+            _cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED)
+            {
+                return;
+            }
+        }
+
+        _sqes = static_cast<io_uring_sqe*>(mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES));
+        if (_sqes == MAP_FAILED)
+        {
+            return;
+        }
+
+        _sq_head = ring_field<uint32_t>(_sq_ring, params.sq_off.head);
+        _sq_tail = ring_field<uint32_t>(_sq_ring, params.sq_off.tail);
+        _sq_mask = *ring_field<uint32_t>(_sq_ring, params.sq_off.ring_mask);
+        _sq_entries = *ring_field<uint32_t>(_sq_ring, params.sq_off.ring_entries);
+        _sq_array = ring_field<uint32_t>(_sq_ring, params.sq_off.array);
+
+        _cq_head = ring_field<uint32_t>(_cq_ring, params.cq_off.head);
+        _cq_tail = ring_field<uint32_t>(_cq_ring, params.cq_off.tail);
+        _cq_mask = *ring_field<uint32_t>(_cq_ring, params.cq_off.ring_mask);
+        _cqes = ring_field<io_uring_cqe>(_cq_ring, params.cq_off.cqes);
+    }
+
+    uring_reactor::~uring_reactor() noexcept
+    {
+        if (_sqes != MAP_FAILED)
+        {
+            munmap(_sqes, _sqes_size);
+        }
+
+        if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring)
+        {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+
+        if (_sq_ring != MAP_FAILED)
+        {
+            munmap(_sq_ring, _sq_ring_size);
+        }
+
+        close(_ring_fd);
+        close(_wake_fd);
+    }
+
+    bool uring_reactor::mapped() const noexcept
+    {
+        return _sq_ring != MAP_FAILED && _cq_ring != MAP_FAILED && _sqes != MAP_FAILED;
+    }
+
+    int64_t uring_reactor::execute(operation& operation) noexcept
+    {
+        io_uring_sqe* sqe = next_sqe();
+        switch (operation.code)
+        {
+            case opcode::read:
+            case opcode::write:
+                sqe->opcode = operation.code == opcode::read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<uint64_t>(operation.buffer);
+                sqe->len = uint32_t(operation.size);
+                sqe->off = uint64_t(operation.offset);
+                break;
+
+            case opcode::recv:
+            case opcode::send:
+                sqe->opcode = operation.code == opcode::recv ? IORING_OP_RECV : IORING_OP_SEND;
+                sqe->addr = reinterpret_cast<uint64_t>(operation.buffer);
+                sqe->len = uint32_t(operation.size);
+                sqe->msg_flags = uint32_t(operation.flags);
+                break;
+
+            case opcode::accept:
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->addr = reinterpret_cast<uint64_t>(operation.address);
+                sqe->addr2 = reinterpret_cast<uint64_t>(operation.address_length);
+                sqe->accept_flags = uint32_t(operation.flags);
+                break;
+
+            case opcode::connect:
+                sqe->opcode = IORING_OP_CONNECT;
+                sqe->addr = reinterpret_cast<uint64_t>(operation.address);
+                sqe->off = *operation.address_length;
+                break;
+
+            case opcode::fsync:
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = (operation.flags & fsync_datasync) ? IORING_FSYNC_DATASYNC : 0;
+                break;
+        }
+
+        sqe->fd = operation.fd;
+        sqe->user_data = reinterpret_cast<uint64_t>(&operation);
+
+        // Published to the kernel by the dispatcher, once we are blocked, so that it can batch submissions
+        store_release(_sq_tail, *_sq_tail + 1);
+        ++_unsubmitted;
+        ++_pending;
+
+        block(operation);
+        return operation.result;
+    }
+
+    void uring_reactor::poll(fiber_pool_base* fiber_pool) noexcept
+    {
+        if (_unsubmitted)
+        {
+            enter(0, 0, nullptr, 0);
+        }
+
+        reap(fiber_pool);
+    }
+
+    void uring_reactor::wait(fiber_pool_base* fiber_pool, const clock::time_point* deadline) noexcept
+    {
+        if (!_wake_armed)
+        {
+            arm_wake();
+        }
+
+        __kernel_timespec timeout{};
+        io_uring_getevents_arg argument{};
+        argument.sigmask_sz = _NSIG / 8;
+
+        if (deadline)
+        {
+            auto remaining = std::max(clock::duration::zero(), *deadline - clock::now());
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+            timeout.tv_sec = seconds.count();
+            timeout.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds).count();
+            argument.ts = reinterpret_cast<uint64_t>(&timeout);
+        }
+
+        enter(1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof(argument));
+        reap(fiber_pool);
+    }
+
+    io_uring_sqe* uring_reactor::next_sqe() noexcept
+    {
+        // Full rings are flushed right away, the kernel copies entries on submission
+        while (*_sq_tail - load_acquire(_sq_head) >= _sq_entries)
+        {
+            enter(0, 0, nullptr, 0);
+        }
+
+        uint32_t index = *_sq_tail & _sq_mask;
+        _sq_array[index] = index;
+
+        io_uring_sqe* sqe = &_sqes[index];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        return sqe;
+    }
+
+    void uring_reactor::arm_wake() noexcept
+    {
+        io_uring_sqe* sqe = next_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = _wake_fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&_wake_value);
+        sqe->len = sizeof(_wake_value);
+        sqe->user_data = wake_user_data;
+
+        store_release(_sq_tail, *_sq_tail + 1);
+        ++_unsubmitted;
+        _wake_armed = true;
+    }
+
+    int uring_reactor::enter(uint32_t min_complete, uint32_t flags, const void* argument, std::size_t argument_size) noexcept
+    {
+        int result = int(syscall(__NR_io_uring_enter, _ring_fd, _unsubmitted, min_complete, flags, argument, argument_size));
+        if (result >= 0)
+        {
+            _unsubmitted -= std::min<uint32_t>(_unsubmitted, uint32_t(result));
+        }
+
+        return result;
+    }
+
+    void uring_reactor::reap(fiber_pool_base* fiber_pool) noexcept
+    {
+        uint32_t head = *_cq_head;
+        const uint32_t tail = load_acquire(_cq_tail);
+
+        while (head != tail)
+        {
+            const io_uring_cqe& cqe = _cqes[head & _cq_mask];
+            if (cqe.user_data == wake_user_data)
+            {
+                _wake_armed = false;
+            }
+            else
+            {
+                --_pending;
+                complete(fiber_pool, *reinterpret_cast<operation*>(cqe.user_data), cqe.res);
+            }
+
+            ++head;
+        }
+
+        store_release(_cq_head, head);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "io/reactor.hpp"
+
+#include <linux/io_uring.h>
+
+
+namespace np::io
+{
+    // Talks to the kernel through the raw syscalls, no liburing needed
+    //  Requires IORING_FEAT_EXT_ARG (Linux 5.11) for timed waits
+    class uring_reactor final : public reactor
+    {
+    public:
+        static uring_reactor* create() noexcept;
+
+        ~uring_reactor() noexcept override;
+
+        int64_t execute(operation& operation) noexcept override;
+        void poll(fiber_pool_base* fiber_pool) noexcept override;
+        void wait(fiber_pool_base* fiber_pool, const clock::time_point* deadline) noexcept override;
+
+    private:
+        uring_reactor(int ring_fd, int wake_fd, const io_uring_params& params) noexcept;
+
+        bool mapped() const noexcept;
+        io_uring_sqe* next_sqe() noexcept;
+        void arm_wake() noexcept;
+        int enter(uint32_t min_complete, uint32_t flags, const void* argument, std::size_t argument_size) noexcept;
+        void reap(fiber_pool_base* fiber_pool) noexcept;
+
+    private:
+        static constexpr uint32_t ring_entries = 256;
+
+        int _ring_fd;
+        uint32_t _unsubmitted;
+        uint64_t _wake_value;
+        bool _wake_armed;
+
+        void* _sq_ring;
+        std::size_t _sq_ring_size;
+        void* _cq_ring;
+        std::size_t _cq_ring_size;
+        io_uring_sqe* _sqes;
+        std::size_t _sqes_size;
+
+        uint32_t* _sq_head;
+        uint32_t* _sq_tail;
+        uint32_t _sq_mask;
+        uint32_t _sq_entries;
+        uint32_t* _sq_array;
+
+        uint32_t* _cq_head;
+        uint32_t* _cq_tail;
+        uint32_t _cq_mask;
+        io_uring_cqe* _cqes;
+    };
+}
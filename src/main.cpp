@@ -112,7 +112,7 @@ void f1_mutex(np::mutex* mutex)
     mutex->lock();
     spdlog::critical("Entered f1 lock");
     assert(++in_critical_section == 1);
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // HACK: DONT
+    np::this_fiber::sleep_for(std::chrono::seconds(1));
     --in_critical_section;
     mutex->unlock();
     spdlog::critical("Unlocked f1 lock");
@@ -123,7 +123,7 @@ void f2_mutex(np::mutex* mutex)
     mutex->lock();
     spdlog::critical("Entered f2 lock");
     assert(++in_critical_section == 1);
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // HACK: DONT
+    np::this_fiber::sleep_for(std::chrono::seconds(1));
     --in_critical_section;
     mutex->unlock();
     spdlog::critical("Unlocked f2 lock");
@@ -134,7 +134,7 @@ void f3_mutex(np::mutex* mutex)
     mutex->lock();
     spdlog::critical("Entered f3 lock");
     assert(++in_critical_section == 1);
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // HACK: DONT
+    np::this_fiber::sleep_for(std::chrono::seconds(1));
     --in_critical_section;
     mutex->unlock();
     spdlog::critical("Unlocked f3 lock");
@@ -144,7 +144,7 @@ std::atomic<uint8_t> count_barrier = 0;
 
 void f1_one_way_barrier(np::one_way_barrier* one_way_barrier)
 {
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // HACK: DONT
+    np::this_fiber::sleep_for(std::chrono::seconds(1));
     ++count_barrier;
     spdlog::critical("Entered f1 oneway");
     one_way_barrier->decrease();
@@ -152,7 +152,7 @@ void f1_one_way_barrier(np::one_way_barrier* one_way_barrier)
 
 void f2_one_way_barrier(np::one_way_barrier* one_way_barrier)
 {
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // HACK: DONT
+    np::this_fiber::sleep_for(std::chrono::seconds(1));
     ++count_barrier;
     spdlog::critical("Entered f2 oneway");
     one_way_barrier->decrease();
@@ -160,7 +160,7 @@ void f2_one_way_barrier(np::one_way_barrier* one_way_barrier)
 
 void f3_one_way_barrier(np::one_way_barrier* one_way_barrier)
 {
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // HACK: DONT
+    np::this_fiber::sleep_for(std::chrono::seconds(1));
     ++count_barrier;
     spdlog::critical("Entered f3 oneway");
     one_way_barrier->decrease();
@@ -217,11 +217,7 @@ void main_pool_b(np::fiber_pool<>& pool, np::executor<>& executor)
     np::counter counter;
     global_counter = 0;
     int max_iters = 2000;
-    for (int i = 0; i < max_iters; ++i)
-    {
-        pool.push([&executor] { yield_and_inc(executor); }, counter);
-        pool.push([&executor] { yield_and_inc(executor); }, counter);
-    }
+    pool.push_n(max_iters * 2, [&executor](std::size_t) { yield_and_inc(executor); }, counter);
 
     spdlog::critical("WAIT {}", max_iters);
     counter.wait();
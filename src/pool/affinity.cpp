@@ -0,0 +1,162 @@
+#include "pool/affinity.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#if defined(__linux__)
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace np
+{
+    namespace
+    {
+#if defined(__linux__)
+        // Missing topology files (ie. offline or virtualized cpus) fall back to the given value
+        uint16_t read_topology(uint16_t cpu, const char* file, uint16_t fallback) noexcept
+        {
+            char path[128];
+            std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/topology/%s", unsigned(cpu), file);
+
+            FILE* handle = std::fopen(path, "r");
+            if (!handle)
+            {
+                return fallback;
+            }
+
+            int value = 0;
+            if (std::fscanf(handle, "%d", &value) != 1 || value < 0)
+            {
+                value = fallback;
+            }
+
+            std::fclose(handle);
+            return uint16_t(value);
+        }
+
+        // Cpus link their node as a nodeN entry in their sysfs directory
+        uint16_t read_node(uint16_t cpu) noexcept
+        {
+            char path[64];
+            std::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u", unsigned(cpu));
+
+            DIR* directory = opendir(path);
+            if (!directory)
+            {
+                return 0;
+            }
+
+            uint16_t node = 0;
+            while (dirent* entry = readdir(directory))
+            {
+                if (std::strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+                {
+                    node = uint16_t(std::atoi(entry->d_name + 4));
+                    break;
+                }
+            }
+
+            closedir(directory);
+            return node;
+        }
+#endif
+    }
+
+    std::vector<cpu_info> available_cpus() noexcept
+    {
+        std::vector<cpu_info> cpus;
+
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (uint16_t cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                {
+                    cpus.push_back({
+                        .cpu = cpu,
+                        .core = read_topology(cpu, "core_id", cpu),
+                        .package = read_topology(cpu, "physical_package_id", 0),
+                        .node = read_node(cpu)
+                    });
+                }
+            }
+        }
+#endif
+
+        if (cpus.empty())
+        {
+            const uint16_t count = std::max<uint16_t>(1, std::thread::hardware_concurrency());
+            for (uint16_t cpu = 0; cpu < count; ++cpu)
+            {
+                cpus.push_back({ .cpu = cpu, .core = cpu, .package = 0, .node = 0 });
+            }
+        }
+
+        std::sort(cpus.begin(), cpus.end(), [](const cpu_info& a, const cpu_info& b) {
+            if (a.node != b.node) return a.node < b.node;
+            if (a.package != b.package) return a.package < b.package;
+            if (a.core != b.core) return a.core < b.core;
+            return a.cpu < b.cpu;
+        });
+
+        return cpus;
+    }
+
+    worker_affinity worker_affinity::cpus(const std::vector<uint16_t>& cpus) noexcept
+    {
+        const auto available = available_cpus();
+
+        worker_affinity affinity;
+        for (uint16_t cpu : cpus)
+        {
+            auto it = std::find_if(available.begin(), available.end(), [cpu](const cpu_info& info) { return info.cpu == cpu; });
+            if (it != available.end())
+            {
+                affinity._cpus.push_back(*it);
+            }
+        }
+
+        return affinity;
+    }
+
+    worker_affinity worker_affinity::physical_cores() noexcept
+    {
+        // Siblings are sorted together, keep the first of every run
+        worker_affinity affinity;
+        for (const cpu_info& info : available_cpus())
+        {
+            if (affinity._cpus.empty() || affinity._cpus.back().package != info.package || affinity._cpus.back().core != info.core)
+            {
+                affinity._cpus.push_back(info);
+            }
+        }
+
+        return affinity;
+    }
+
+    namespace detail
+    {
+        bool pin_this_thread(uint16_t cpu) noexcept
+        {
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+            (void)cpu;
+            return false;
+#endif
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace np
+{
+    // A logical cpu and where it sits in the machine
+    struct cpu_info
+    {
+        uint16_t cpu;
+        uint16_t core;
+        uint16_t package;
+        uint16_t node;
+    };
+
+    // Logical cpus the process may run on, ordered by node, package, core and cpu
+    //  Only Linux reports the topology, elsewhere every cpu is its own core on node 0
+    std::vector<cpu_info> available_cpus() noexcept;
+
+    // Where the workers of a pool run, by default wherever the OS puts them
+    //  Workers take the cpus in order and wrap around if there are more workers than cpus
+    class worker_affinity
+    {
+    public:
+        worker_affinity() noexcept = default;
+
+        // Cpus not available to the process are left out
+        static worker_affinity cpus(const std::vector<uint16_t>& cpus) noexcept;
+
+        // First logical cpu of every physical core, so that no two workers share a core
+        static worker_affinity physical_cores() noexcept;
+
+        inline bool empty() const noexcept;
+        inline std::size_t size() const noexcept;
+        inline const cpu_info& operator[](std::size_t worker) const noexcept;
+
+    private:
+        std::vector<cpu_info> _cpus;
+    };
+
+    namespace detail
+    {
+        // False if the thread could not be pinned, or pinning isn't supported
+        bool pin_this_thread(uint16_t cpu) noexcept;
+    }
+
+
+    inline bool worker_affinity::empty() const noexcept
+    {
+        return _cpus.empty();
+    }
+
+    inline std::size_t worker_affinity::size() const noexcept
+    {
+        return _cpus.size();
+    }
+
+    inline const cpu_info& worker_affinity::operator[](std::size_t worker) const noexcept
+    {
+        return _cpus[worker % _cpus.size()];
+    }
+}
@@ -1,6 +1,10 @@
 #include "pool/fiber_pool.hpp"
 #include "core/fiber.hpp"
 
+#if defined(__linux__)
+#include "io/reactor.hpp"
+#endif
+
 #include <spdlog/spdlog.h>
 
 
@@ -8,19 +12,37 @@
 namespace np
 {
     std::atomic<uint8_t> fiber_pool_base::_fiber_worker_id = 0;
+    std::array<std::atomic<bool>, 256> fiber_pool_base::_worker_id_in_use {};
     std::array<std::thread::id, 256> fiber_pool_base::_thread_ids {};
     std::array<np::fiber_base*, 256> fiber_pool_base::_running_fibers {};
     std::array<np::fiber_base*, 256> fiber_pool_base::_dispatcher_fibers {};
 
     fiber_pool_base::fiber_pool_base(bool create_instance) noexcept :
         _running(false),
+        _work_stealing(false),
+        _idle_park(false),
         _number_of_threads(0),
         _number_of_spawned_fibers(0),
         _target_number_of_fibers(0),
         _worker_threads(),
-        _fibers(),
+        _worker_ids(),
         _awaiting_fibers(),
-        _barrier(0)
+        _local_fibers(),
+        _yield_priority(1),
+        _priority_streaks(),
+        _prioritized(),
+        _coroutines(),
+        _inboxes(),
+        _pinned(false),
+        _numa(false),
+        _worker_cpus(),
+        _counters(),
+        _queue_stats(nullptr),
+        _barrier(0),
+        _idle(),
+        _timers(),
+        _reactors(),
+        _reactor_sleepers(0)
 #ifdef TAMASHII_INTERNAL_FIBER_POOL_TRACK_BLOCKED
         , _number_of_blocked_fibers(0)
 #endif
@@ -39,6 +61,23 @@ namespace np
         return _running_fibers[thread_index()];
     }
 
+    fiber_pool_base* NP_NOINLINE fiber_pool_base::running_pool() noexcept
+    {
+        return _this_thread_pool;
+    }
+
+    fiber_base* NP_NOINLINE fiber_pool_base::running_fiber() noexcept
+    {
+        if (_this_thread_pool == nullptr)
+        {
+            return nullptr;
+        }
+
+        uint8_t index = _this_thread_index;
+        fiber_base* fiber = _running_fibers[index];
+        return fiber != _dispatcher_fibers[index] ? fiber : nullptr;
+    }
+
     void fiber_pool_base::yield() noexcept
     {
         auto index = thread_index();
@@ -52,6 +91,20 @@ namespace np
         fiber->yield(dispatcher);
     }
 
+    void fiber_pool_base::sleep_until(std::chrono::steady_clock::time_point deadline) noexcept
+    {
+        // Lives on this fiber's stack, whoever pops it must not touch it after unblocking us
+        detail::timer timer{ deadline, this_fiber(), 0, nullptr };
+        add_timer(timer);
+        block();
+    }
+
+    void fiber_pool_base::set_sticky(bool sticky) noexcept
+    {
+        auto index = thread_index();
+        _running_fibers[index]->_worker = sticky ? index : detail::unpinned;
+    }
+
     void fiber_pool_base::block() noexcept
     {
         auto index = thread_index();
@@ -71,24 +124,285 @@ namespace np
         --_number_of_blocked_fibers;
 #endif
 
-        _awaiting_fibers.enqueue(fiber);
+        // Once scheduled it may run and change its worker, read it before
+        const uint8_t worker = fiber->_worker;
+        schedule(fiber);
+
+        if (worker == detail::unpinned)
+        {
+            notify_idle();
+        }
+        else
+        {
+            notify_worker(worker);
+        }
+    }
+
+    void fiber_pool_base::resume(std::coroutine_handle<> coroutine) noexcept
+    {
+        _coroutines.enqueue(coroutine);
+        notify_idle();
+    }
+
+    bool fiber_pool_base::resume_coroutine(uint8_t idx) noexcept
+    {
+        std::coroutine_handle<> coroutine;
+        if (!_coroutines.try_dequeue(coroutine))
+        {
+            return false;
+        }
+
+        // Tasks run on the dispatcher, whatever they call must not see the last fiber as running
+        _running_fibers[idx] = _dispatcher_fibers[idx];
+        detail::bump(_counters[idx]->coroutine_resumes);
+        coroutine.resume();
+        return true;
+    }
+
+    void fiber_pool_base::spawn(np::task<>&& task) noexcept
+    {
+        spawn(std::move(task), *get_dummy_counter());
+    }
+
+    void fiber_pool_base::spawn(np::task<>&& task, np::counter& counter) noexcept
+    {
+        counter.increase(badge());
+
+        auto coroutine = task.release(badge());
+        coroutine.promise().detach(badge(), this, &counter);
+        resume(coroutine);
+    }
+
+    void fiber_pool_base::schedule(np::fiber_base* fiber) noexcept
+    {
+        if (fiber->_worker != detail::unpinned)
+        {
+            worker_inbox* inbox = _inboxes[fiber->_worker];
+            inbox->pending.fetch_add(1, std::memory_order_relaxed);
+            inbox->fibers.enqueue(fiber);
+            return;
+        }
+
+        const uint8_t level = static_cast<uint8_t>(fiber->_priority);
+        if (fiber->_priority != np::priority::normal)
+        {
+            _prioritized[level].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (_work_stealing)
+        {
+            // Only the owner may push into a deque, foreign threads (or pools) go through the shared queue
+            uint8_t index;
+            if (worker_index(index) && _local_fibers[index][level])
+            {
+                _local_fibers[index][level]->push(fiber);
+                return;
+            }
+        }
+
+        _awaiting_fibers[level].enqueue(fiber);
+    }
+
+    void fiber_pool_base::schedule_bulk(np::fiber_base** fibers, std::size_t count) noexcept
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        assert(fibers[0]->_worker == detail::unpinned && "Pinned fibers can't be scheduled in bulk");
+
+        const uint8_t level = static_cast<uint8_t>(fibers[0]->_priority);
+        if (fibers[0]->_priority != np::priority::normal)
+        {
+            _prioritized[level].fetch_add(uint32_t(count), std::memory_order_relaxed);
+        }
+
+        if (_work_stealing)
+        {
+            uint8_t index;
+            if (worker_index(index) && _local_fibers[index][level])
+            {
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    _local_fibers[index][level]->push(fibers[i]);
+                }
+
+                return;
+            }
+        }
+
+        _awaiting_fibers[level].enqueue_bulk(fibers, count);
+    }
+
+    bool fiber_pool_base::next_awaiting(uint8_t idx, np::fiber_base*& fiber) noexcept
+    {
+        worker_inbox* inbox = _inboxes[idx];
+        if (inbox && inbox->turn && next_pinned(idx, fiber))
+        {
+            inbox->turn = false;
+            return true;
+        }
+
+        if (next_queued(idx, fiber))
+        {
+            if (inbox)
+            {
+                inbox->turn = true;
+            }
+
+            return true;
+        }
+
+        return next_pinned(idx, fiber);
+    }
+
+    bool fiber_pool_base::next_pinned(uint8_t idx, np::fiber_base*& fiber) noexcept
+    {
+        worker_inbox* inbox = _inboxes[idx];
+        if (!inbox || inbox->pending.load(std::memory_order_relaxed) == 0 || !inbox->fibers.try_dequeue(fiber))
+        {
+            return false;
+        }
+
+        inbox->pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool fiber_pool_base::next_queued(uint8_t idx, np::fiber_base*& fiber) noexcept
+    {
+        // Starting at the first level that didn't use up its streak, and wrapping around if lower ones are empty
+        const uint8_t first = first_priority(idx);
+        for (uint8_t i = 0; i < detail::number_of_priorities; ++i)
+        {
+            const uint8_t level = uint8_t((first + i) % detail::number_of_priorities);
+            const bool normal = level == static_cast<uint8_t>(np::priority::normal);
+            if (!normal && _prioritized[level].load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+
+            if (next_awaiting(idx, level, fiber))
+            {
+                if (!normal)
+                {
+                    _prioritized[level].fetch_sub(1, std::memory_order_relaxed);
+                }
+
+                picked_priority(idx, level);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool fiber_pool_base::next_awaiting(uint8_t idx, uint8_t level, np::fiber_base*& fiber) noexcept
+    {
+        if (!_work_stealing)
+        {
+            return _awaiting_fibers[level].try_dequeue(fiber);
+        }
+
+        // The owner takes from the top as well, popping from the bottom would be LIFO, and fibers that
+        //  spin on yield would starve whatever they are waiting for
+        if ((fiber = _local_fibers[idx][level]->steal()))
+        {
+            return true;
+        }
+
+        return _awaiting_fibers[level].try_dequeue(fiber) || steal(idx, level, fiber);
+    }
+
+    bool fiber_pool_base::steal(uint8_t idx, uint8_t level, np::fiber_base*& fiber) noexcept
+    {
+        // xorshift32, it only has to spread thieves across victims
+        thread_local uint32_t seed = 2463534242u ^ (uint32_t(idx) << 16);
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        // Workers on our own node go first, then the rest, all of them are on one node unless pinned across nodes
+        const std::size_t size = _worker_ids.size();
+        for (int pass = _numa ? 0 : 1; pass < 2; ++pass)
+        {
+            for (std::size_t i = 0, start = seed % size; i < size; ++i)
+            {
+                uint8_t victim = _worker_ids[(start + i) % size];
+                if (victim == idx || !_local_fibers[victim][level])
+                {
+                    continue;
+                }
+
+                if (_numa && (pass == 0) != (_worker_cpus[victim].node == _worker_cpus[idx].node))
+                {
+                    continue;
+                }
+
+                if ((fiber = _local_fibers[victim][level]->steal()))
+                {
+                    detail::bump(_counters[idx]->steals);
+                    return true;
+                }
+            }
+        }
+
+        return false;
     }
 
     uint8_t NP_NOINLINE fiber_pool_base::thread_index() noexcept
     {
-        auto tid = std::this_thread::get_id();
-        for (int idx = 0, size = _fiber_worker_id; idx < size; ++idx)
+        if (_this_thread_pool == nullptr)
         {
-            if (_thread_ids[idx] == tid)
+            abort();
+            unreachable();
+        }
+
+        return _this_thread_index;
+    }
+
+    bool NP_NOINLINE fiber_pool_base::worker_index(uint8_t& index) const noexcept
+    {
+        if (_this_thread_pool != this)
+        {
+            return false;
+        }
+
+        index = _this_thread_index;
+        return true;
+    }
+
+    uint32_t NP_NOINLINE fiber_pool_base::count_push() noexcept
+    {
+        return ++_pushes;
+    }
+
+    uint8_t fiber_pool_base::acquire_worker_id() noexcept
+    {
+        // Ids are global, recycle those of destroyed pools so that pools can come and go
+        //  The last id is never handed out, as the high-water mark must fit in an uint8_t
+        for (int idx = 0; idx < 255; ++idx)
+        {
+            if (!_worker_id_in_use[idx].exchange(true, std::memory_order_acquire))
             {
-                return idx;
+                uint8_t current = _fiber_worker_id;
+                while (current <= idx && !_fiber_worker_id.compare_exchange_weak(current, uint8_t(idx + 1)))
+                {}
+
+                return uint8_t(idx);
             }
         }
 
+        assert(false && "Exhausted all worker ids");
         abort();
         unreachable();
     }
 
+    void fiber_pool_base::release_worker_id(uint8_t worker_id) noexcept
+    {
+        _worker_id_in_use[worker_id].store(false, std::memory_order_release);
+    }
+
     np::counter* fiber_pool_base::get_dummy_counter() noexcept
     {
         return &detail::dummy_counter;
@@ -98,4 +412,144 @@ namespace np
     {
         return _fiber_worker_id;
     }
+
+    pool_stats fiber_pool_base::stats() const noexcept
+    {
+        pool_stats stats{};
+
+        for (uint8_t worker_id : _worker_ids)
+        {
+            // Non-dispatching main threads have nothing to count
+            if (!_counters[worker_id])
+            {
+                continue;
+            }
+
+            worker_stats worker{};
+            worker.worker_id = worker_id;
+            _counters[worker_id]->collect(worker);
+            _counters[worker_id]->collect(stats.total);
+            stats.workers.push_back(worker);
+
+            stats.runnable_fibers += _inboxes[worker_id]->pending.load(std::memory_order_relaxed);
+            for (const auto& deque : _local_fibers[worker_id])
+            {
+                stats.runnable_fibers += deque ? deque->size_approx() : 0;
+            }
+        }
+
+        for (const auto& queue : _awaiting_fibers)
+        {
+            stats.runnable_fibers += queue.size_approx();
+        }
+
+        stats.runnable_coroutines = _coroutines.size_approx();
+
+        stats.spawned_fibers = _number_of_spawned_fibers;
+        _queue_stats(this, stats);
+        return stats;
+    }
+
+#if defined(__linux__)
+    io::reactor* fiber_pool_base::this_reactor(protected_access_t) noexcept
+    {
+        // Dispatchers and threads outside of pools can't block
+        fiber_pool_base* pool = _this_thread_pool;
+        uint8_t idx = _this_thread_index;
+        if (!pool || _running_fibers[idx] == _dispatcher_fibers[idx])
+        {
+            return nullptr;
+        }
+
+        // Only this worker creates it, others just look at it to wake it
+        io::reactor* reactor = pool->_reactors[idx].load(std::memory_order_relaxed);
+        if (!reactor)
+        {
+            reactor = io::reactor::create();
+            pool->_reactors[idx].store(reactor, std::memory_order_release);
+        }
+
+        return reactor;
+    }
+
+    io::reactor* fiber_pool_base::busy_reactor(uint8_t idx) noexcept
+    {
+        io::reactor* reactor = _reactors[idx].load(std::memory_order_relaxed);
+        return reactor && reactor->pending() ? reactor : nullptr;
+    }
+
+    void fiber_pool_base::prepare_reactor_sleep(io::reactor* reactor) noexcept
+    {
+        // Pairs with the fence in eventcount::notify, either the notifier sees us or we see its work
+        reactor->sleeping(true);
+        _reactor_sleepers.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void fiber_pool_base::cancel_reactor_sleep(io::reactor* reactor) noexcept
+    {
+        reactor->sleeping(false);
+        _reactor_sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void fiber_pool_base::reactor_sleep(io::reactor* reactor) noexcept
+    {
+        if (_timers.empty())
+        {
+            reactor->wait(this, nullptr);
+        }
+        else
+        {
+            auto deadline = _timers.next_deadline();
+            reactor->wait(this, &deadline);
+        }
+
+        cancel_reactor_sleep(reactor);
+    }
+
+    void fiber_pool_base::wake_reactors(bool all) noexcept
+    {
+        for (uint8_t worker_id : _worker_ids)
+        {
+            io::reactor* reactor = _reactors[worker_id].load(std::memory_order_acquire);
+            if (reactor && reactor->wake() && !all)
+            {
+                return;
+            }
+        }
+    }
+
+    void fiber_pool_base::wake_reactor(uint8_t worker_id) noexcept
+    {
+        if (io::reactor* reactor = _reactors[worker_id].load(std::memory_order_acquire))
+        {
+            reactor->wake();
+        }
+    }
+
+    void fiber_pool_base::poll_reactor(io::reactor* reactor) noexcept
+    {
+        if (reactor->pending())
+        {
+            reactor->poll(this);
+        }
+    }
+
+    void fiber_pool_base::destroy_reactors() noexcept
+    {
+        for (auto& reactor : _reactors)
+        {
+            delete reactor.exchange(nullptr);
+        }
+    }
+#else
+    io::reactor* fiber_pool_base::this_reactor(protected_access_t) noexcept { return nullptr; }
+    io::reactor* fiber_pool_base::busy_reactor(uint8_t) noexcept { return nullptr; }
+    void fiber_pool_base::prepare_reactor_sleep(io::reactor*) noexcept {}
+    void fiber_pool_base::cancel_reactor_sleep(io::reactor*) noexcept {}
+    void fiber_pool_base::reactor_sleep(io::reactor*) noexcept {}
+    void fiber_pool_base::wake_reactors(bool) noexcept {}
+    void fiber_pool_base::wake_reactor(uint8_t) noexcept {}
+    void fiber_pool_base::poll_reactor(io::reactor*) noexcept {}
+    void fiber_pool_base::destroy_reactors() noexcept {}
+#endif
 }
@@ -1,13 +1,26 @@
 #pragma once
 
+#include "container/spmc_queue.hpp"
 #include "core/fiber.hpp"
+#include "coroutine/task.hpp"
 #include "utils/badge.hpp"
 #include "synchronization/counter.hpp"
+#include "synchronization/eventcount.hpp"
 #include "synchronization/spinbarrier.hpp"
+#include "pool/affinity.hpp"
+#include "pool/future.hpp"
+#include "pool/stack_profile.hpp"
+#include "pool/stats.hpp"
+#include "pool/task_storage.hpp"
+#include "pool/timer_queue.hpp"
 
 #include <concurrentqueue.h>
 
+#include <algorithm>
 #include <array>
+#include <iterator>
+#include <limits>
+#include <ranges>
 #include <thread>
 #include <vector>
 
@@ -47,6 +60,17 @@ namespace np
     template <typename traits> class fiber_pool;
 
     class mutex;
+
+    namespace detail
+    {
+        class wait_queue;
+        struct yield_awaiter;
+    }
+
+    namespace io
+    {
+        class reactor;
+    }
     class counter;
     class condition_variable;
     class one_way_barrier;
@@ -56,8 +80,36 @@ namespace np
 
 namespace np
 {
+    // Stack size a task asks for when pushed, it indexes the pool traits' stack_size_classes
+    enum class stack_class : uint8_t {};
+
+    struct stack_size_class
+    {
+        uint32_t stack_size;
+        uint32_t maximum_fibers;
+    };
+
     namespace detail
     {
+        // Yields a task calling function(index) for every index, without materializing them all
+        template <typename F>
+        struct indexed_task_iterator
+        {
+            const F* function;
+            std::size_t index;
+
+            auto operator*() const noexcept
+            {
+                return [function = *function, index = index] { function(index); };
+            }
+
+            indexed_task_iterator& operator++() noexcept
+            {
+                ++index;
+                return *this;
+            }
+        };
+
         inline void invalid_fiber_guard()
         {
             assert(false && "Attempting to use a fiber without task");
@@ -67,15 +119,62 @@ namespace np
         {
             // Fiber pool traits
             static const bool preemtive_fiber_creation = true;
+            static const bool work_stealing = false;
             static const uint32_t maximum_fibers = 300;
+
+            // Pushing only queues the task, workers bind it to a fiber once they start it, and the fiber of a
+            //  task that just ended goes on with the next one on the same worker. Queued tasks hold no stack
+            //  Tasks pinned to a worker are still bound when pushed
+            static const bool lazy_fiber_binding = false;
+
+            // Times in a row a priority may be picked while lower ones wait, before one of those goes first
             static const uint32_t yield_priority = 2;
             static const uint16_t maximum_threads = 256;
 
+            // Idle dispatchers spin, then yield their thread, and finally park until there is work
+            //  Without parking they keep on yielding, use the maximum spin count to never leave the spin
+            static const uint32_t idle_spin_iterations = 1024;
+            static const uint32_t idle_yield_iterations = 64;
+            static const bool idle_park = true;
+
+            // One task in every wait_time_sampling gets timestamped for the wait histograms of stats, 0 disables it
+            static const uint32_t wait_time_sampling = 16;
+
+            // Results of async tasks are stored inline in their future's slot, which is this big
+            static const uint32_t future_storage_size = 64;
+
+            // Closures over inplace_function_size are moved to pooled blocks of task_storage_size bytes, and those
+            //  that don't fit there either to the heap, tasks only keep a pointer to them
+            static const uint32_t task_storage_size = 256;
+
             // Fiber traits
             static const uint32_t inplace_function_size = 64;
             static const uint32_t fiber_stack_size = 524288;
+
+            // Paints stacks with a canary and measures how deep every task went, see stack_profile
+            //  Each finished task scans its stack and all stack pages get committed, meant for profiling only
+            static const bool profile_stacks = false;
+
+            // Every size class keeps its own fibers, tasks run in the first one unless pushed with another
+            //  Left empty there is a single class of fiber_stack_size with maximum_fibers
+            //  Dispatchers always get fiber_stack_size
+            using stack_allocator = np::default_stack_allocator;
+            static constexpr std::array<np::stack_size_class, 0> stack_size_classes = {};
         };
 
+        template <typename traits>
+        constexpr auto stack_size_classes_of() noexcept
+        {
+            if constexpr (traits::stack_size_classes.size() == 0)
+            {
+                return std::array<np::stack_size_class, 1> { { { traits::fiber_stack_size, traits::maximum_fibers } } };
+            }
+            else
+            {
+                return traits::stack_size_classes;
+            }
+        }
+
         inline fiber_pool_base* fiber_pool_instance = nullptr;
     }
 
@@ -91,13 +190,41 @@ namespace np
         static fiber_base* this_fiber() noexcept;
         void yield() noexcept;
 
-        using protected_access_t = ::badge<np::mutex, np::one_way_barrier, np::barrier, np::counter, np::condition_variable, np::event>;
+        // Fiber running on the calling thread, or null if it isn't running one of a pool's fibers
+        static NP_NOINLINE fiber_base* running_fiber() noexcept;
+
+        // Blocks the calling fiber until deadline, its worker keeps running other fibers meanwhile
+        void sleep_until(std::chrono::steady_clock::time_point deadline) noexcept;
+
+        // Sticky fibers stay on their current worker, they come back to it after yielding or blocking
+        void set_sticky(bool sticky) noexcept;
+
+        // Pool whose dispatcher runs the calling thread, or null outside of pools
+        static NP_NOINLINE fiber_pool_base* running_pool() noexcept;
+
+        // Tasks run on the dispatchers' own stacks, taking turns with fibers, the counter is done once they return
+        void spawn(np::task<>&& task) noexcept;
+        void spawn(np::task<>&& task, np::counter& counter) noexcept;
+
+        using protected_access_t = ::badge<np::mutex, np::one_way_barrier, np::barrier, np::counter, np::condition_variable, np::event, np::detail::wait_queue, np::detail::yield_awaiter, np::io::reactor>;
 
         inline void block(protected_access_t) noexcept;
         inline void unblock(protected_access_t, np::fiber_base* fiber) noexcept;
+        inline void resume(protected_access_t, std::coroutine_handle<> coroutine) noexcept;
+        inline void add_timer(protected_access_t, detail::timer& timer) noexcept;
+        inline bool remove_timer(protected_access_t, detail::timer& timer) noexcept;
+
+        // Reactor of the calling fiber's worker, created on first use, or null outside of pool fibers
+        static NP_NOINLINE io::reactor* this_reactor(protected_access_t) noexcept;
+
         inline uint16_t number_of_threads() const noexcept;
         inline uint32_t target_number_of_fibers() const noexcept;
 
+        // Ids as seen by thread_index, valid once the pool is started
+        //  The main worker only runs fibers when the pool was started with the main thread
+        inline const std::vector<uint8_t>& worker_ids() const noexcept;
+        inline uint8_t main_worker_id() const noexcept;
+
         template <typename T>
         static std::array<T, 256>& threadlocal_all() noexcept;
 
@@ -106,12 +233,64 @@ namespace np
 
         static uint8_t maximum_worker_id() noexcept;
 
+        // Aggregates every worker's counters and looks at the queues, cheap enough to be called periodically
+        pool_stats stats() const noexcept;
+
     protected:
         np::counter* get_dummy_counter() noexcept;
 
         void block() noexcept;
         void unblock(fiber_base* fiber) noexcept;
 
+        // Queues a suspended task to be resumed by any dispatcher, and resumes one if there is any
+        void resume(std::coroutine_handle<> coroutine) noexcept;
+        bool resume_coroutine(uint8_t idx) noexcept;
+
+        // Awaiting fibers go to the calling worker's deque when work stealing, or to the shared queue otherwise
+        //  Every priority has its own queues, bulk scheduled fibers must all share the same priority
+        //  Pinned fibers skip all of them and go to their worker's inbox
+        void schedule(np::fiber_base* fiber) noexcept;
+        void schedule_bulk(np::fiber_base** fibers, std::size_t count) noexcept;
+        bool next_awaiting(uint8_t idx, np::fiber_base*& fiber) noexcept;
+        bool next_queued(uint8_t idx, np::fiber_base*& fiber) noexcept;
+        bool next_pinned(uint8_t idx, np::fiber_base*& fiber) noexcept;
+        bool next_awaiting(uint8_t idx, uint8_t level, np::fiber_base*& fiber) noexcept;
+        bool steal(uint8_t idx, uint8_t level, np::fiber_base*& fiber) noexcept;
+
+        // First priority a worker looks at, levels that ran yield_priority times in a row let lower ones go first
+        inline uint8_t first_priority(uint8_t idx) const noexcept;
+        inline void picked_priority(uint8_t idx, uint8_t level) noexcept;
+
+        // Unblocks every fiber whose timer is due, called by dispatchers on every loop
+        inline void expire_timers() noexcept;
+        inline void add_timer(detail::timer& timer) noexcept;
+
+        // Dispatchers submit and reap I/O on every loop, and sleep in their reactor while it has work in flight
+        inline void poll_reactor(uint8_t idx) noexcept;
+        io::reactor* busy_reactor(uint8_t idx) noexcept;
+        void prepare_reactor_sleep(io::reactor* reactor) noexcept;
+        void cancel_reactor_sleep(io::reactor* reactor) noexcept;
+        void reactor_sleep(io::reactor* reactor) noexcept;
+        void wake_reactors(bool all) noexcept;
+        void poll_reactor(io::reactor* reactor) noexcept;
+        void destroy_reactors() noexcept;
+
+        // Wakes a parked dispatcher, if any, after publishing work from outside the dispatcher loop
+        inline void notify_idle() noexcept;
+        inline void notify_idle(std::size_t count) noexcept;
+
+        // Dispatchers share the eventcount, so waking a given one wakes everyone parked
+        inline void notify_worker(uint8_t worker_id) noexcept;
+        void wake_reactor(uint8_t worker_id) noexcept;
+
+        NP_NOINLINE bool worker_index(uint8_t& index) const noexcept;
+
+        // Pushes made so far by the calling thread, this one included
+        static NP_NOINLINE uint32_t count_push() noexcept;
+
+        static uint8_t acquire_worker_id() noexcept;
+        static void release_worker_id(uint8_t worker_id) noexcept;
+
         inline constexpr auto badge()
         {
             return ::badge<fiber_pool_base>{};
@@ -121,22 +300,67 @@ namespace np
     protected:
         ~fiber_pool_base() noexcept = default;
 
+    protected:
+        struct alignas(detail::cacheline_length) priority_streaks
+        {
+            std::array<uint32_t, detail::number_of_priorities> picks;
+        };
+
+        // Fibers pinned to a worker, anyone may push but only its dispatcher pops
+        struct alignas(detail::cacheline_length) worker_inbox
+        {
+            moodycamel::ConcurrentQueue<np::fiber_base*> fibers;
+            std::atomic<uint32_t> pending;
+
+            // Pinned fibers take turns with the rest, a yielding one would keep its worker to itself otherwise
+            bool turn;
+        };
+
     protected:
         static std::atomic<uint8_t> _fiber_worker_id;
+        static std::array<std::atomic<bool>, 256> _worker_id_in_use;
         static std::array<std::thread::id, 256> _thread_ids;
+
+        // Worker slot of the calling thread, set when a thread starts dispatching (or enables main thread calls)
+        //  Reads must go through non-inlined functions, a fiber may resume on another thread and compilers
+        //  are free to cache the address of thread locals across calls
+        inline static thread_local uint8_t _this_thread_index = 0;
+        inline static thread_local fiber_pool_base* _this_thread_pool = nullptr;
+        inline static thread_local uint32_t _pushes = 0;
         static std::array<np::fiber_base*, 256> _running_fibers;
         static std::array<np::fiber_base*, 256> _dispatcher_fibers;
 
         bool _running;
         bool _with_main_thread;
+        bool _work_stealing;
+        bool _idle_park;
         uint8_t _main_worker_id;
         uint16_t _number_of_threads;
         uint32_t _number_of_spawned_fibers;
         uint32_t _target_number_of_fibers;
         std::vector<std::thread> _worker_threads;
-        moodycamel::ConcurrentQueue<np::fiber_base*> _fibers;
-        moodycamel::ConcurrentQueue<np::fiber_base*> _awaiting_fibers;
+        std::vector<uint8_t> _worker_ids;
+        std::array<moodycamel::ConcurrentQueue<np::fiber_base*>, detail::number_of_priorities> _awaiting_fibers;
+        std::array<std::array<np::spmc_queue<np::fiber_base>*, detail::number_of_priorities>, 256> _local_fibers;
+        uint32_t _yield_priority;
+        std::array<priority_streaks, 256> _priority_streaks;
+        // Fibers waiting at each priority but normal, pools that never use them don't probe their queues
+        alignas(detail::cacheline_length) std::array<std::atomic<uint32_t>, detail::number_of_priorities> _prioritized;
+        // Suspended tasks ready to go on, shared by all dispatchers
+        moodycamel::ConcurrentQueue<std::coroutine_handle<>> _coroutines;
+        std::array<worker_inbox*, 256> _inboxes;
+        bool _pinned;
+        bool _numa;
+        std::array<np::cpu_info, 256> _worker_cpus;
+        std::array<detail::worker_counters*, 256> _counters;
+
+        // Pools know their own task and fiber queues
+        void (*_queue_stats)(const fiber_pool_base* pool, pool_stats& stats) noexcept;
         np::spinbarrier _barrier;
+        np::eventcount _idle;
+        detail::timer_queue _timers;
+        std::array<std::atomic<io::reactor*>, 256> _reactors;
+        std::atomic<uint32_t> _reactor_sleepers;
 
 #ifdef TAMASHII_INTERNAL_FIBER_POOL_TRACK_BLOCKED
         std::atomic<uint32_t> _number_of_blocked_fibers;
@@ -150,10 +374,43 @@ namespace np
     template <typename traits = detail::default_fiber_pool_traits>
     class fiber_pool : public fiber_pool_base
     {
+    public:
+        static constexpr auto stack_size_classes = detail::stack_size_classes_of<traits>();
+
+    private:
+        static constexpr std::size_t number_of_stack_classes = stack_size_classes.size();
+        static_assert(number_of_stack_classes > 0 && number_of_stack_classes <= 256, "Pools need between 1 and 256 stack size classes");
+        static_assert(traits::yield_priority > 0, "A yield priority of 0 would always run the lowest priority first");
+
         struct task_bundle
         {
             np::counter* counter;
             stdext::inplace_function<void(), traits::inplace_function_size> function;
+            uint8_t worker;
+            const detail::stack_site* site;
+            std::chrono::steady_clock::time_point pushed_at;
+        };
+
+        // Lets enqueue_bulk build task bundles straight from the callables
+        template <typename It>
+        struct task_bundle_iterator
+        {
+            fiber_pool<traits>* pool;
+            It it;
+            np::counter* counter;
+            const detail::stack_site* site;
+            std::chrono::steady_clock::time_point pushed_at;
+
+            task_bundle operator*() noexcept
+            {
+                return { .counter = counter, .function = pool->fit(*it), .worker = detail::unpinned, .site = site, .pushed_at = pushed_at };
+            }
+
+            task_bundle_iterator& operator++() noexcept
+            {
+                ++it;
+                return *this;
+            }
         };
 
     public:
@@ -162,7 +419,13 @@ namespace np
 
         static fiber_pool<traits>* instance() noexcept;
 
-        void start(uint16_t number_of_threads = 0, bool with_main_thread = true) noexcept;
+        // Workers allocate their dispatcher once running and, if pinned, their share of fibers, so that both
+        //  are first touched from their node. When workers span nodes fiber stacks are committed as they are
+        //  created, they would otherwise be faulted in by whoever runs them, fibers being shared by all workers
+        //  Without a number of threads there is one per cpu of the affinity
+        //  Fibers are created on start, tasks pushed before wait for it
+        //  The main thread, if it runs a dispatcher, stays pinned after joining
+        void start(uint16_t number_of_threads = 0, bool with_main_thread = true, const np::worker_affinity& affinity = {}) noexcept;
         void enable_main_thread_calls_here() noexcept;
         void end() noexcept;
         void join() noexcept;
@@ -170,17 +433,119 @@ namespace np
         template <typename F>
         void push(F&& function) noexcept;
 
+        template <typename F>
+        void push(F&& function, np::stack_class stack) noexcept;
+
         template <typename F>
         void push(F&& function, np::counter& counter) noexcept;
 
+        template <typename F>
+        void push(F&& function, np::counter& counter, np::stack_class stack) noexcept;
+
+        template <typename F>
+        void push(F&& function, np::priority priority) noexcept;
+
+        template <typename F>
+        void push(F&& function, np::counter& counter, np::priority priority) noexcept;
+
+        template <typename F>
+        void push(F&& function, np::counter& counter, np::stack_class stack, np::priority priority) noexcept;
+
+        // Runs the task on the given worker only, see worker_ids, pinned fibers are never stolen
+        //  Workers' inboxes are created on start, so pinning a task must wait for the pool to start
+        template <typename F>
+        void push_to(uint8_t worker_id, F&& function) noexcept;
+
+        template <typename F>
+        void push_to(uint8_t worker_id, F&& function, np::counter& counter) noexcept;
+
+        template <typename F>
+        void push_to(uint8_t worker_id, F&& function, np::counter& counter, np::stack_class stack) noexcept;
+
+        // Pushes every callable in range, the counter is increased once and queues are touched in bulk
+        template <typename R>
+        void push_bulk(R&& range, np::counter& counter) noexcept;
+
+        template <typename R>
+        void push_bulk(R&& range, np::counter& counter, np::stack_class stack) noexcept;
+
+        // Pushes n tasks, the i-th of them calls function(i)
+        template <typename F>
+        void push_n(std::size_t n, F&& function, np::counter& counter) noexcept;
+
+        template <typename F>
+        void push_n(std::size_t n, F&& function, np::counter& counter, np::stack_class stack) noexcept;
+
+        // Pushes the task and returns a future to its result, which is stored in a pooled slot
+        template <typename F>
+        auto async(F&& function) noexcept;
+
+        template <typename F>
+        auto async(F&& function, np::stack_class stack) noexcept;
+
+        template <typename F>
+        auto async(F&& function, np::priority priority) noexcept;
+
+        template <typename F>
+        auto async(F&& function, np::stack_class stack, np::priority priority) noexcept;
+
+        // Smallest class with at least stack_size bytes, or the biggest one if none is large enough
+        static constexpr np::stack_class stack_class_for(std::size_t stack_size) noexcept;
+
+        // Stack use of every task that finished so far, empty unless the profile_stacks trait is set
+        np::stack_profile_report stack_profile() const noexcept;
+
     private:
+        template <typename F>
+        void submit(F&& function, np::counter& counter, np::stack_class stack, np::priority priority, uint8_t worker) noexcept;
+
+        template <typename It>
+        void submit_bulk(It first, std::size_t count, np::counter& counter, np::stack_class stack, np::priority priority, const detail::stack_site* site) noexcept;
+
+        // Tasks are grouped by the type of their callable
+        template <typename F>
+        static const detail::stack_site* stack_site_of() noexcept;
+
+        // The callable itself if it fits inline, otherwise one that runs and frees a stored copy of it
+        template <typename F>
+        decltype(auto) fit(F&& function) noexcept;
+
         void worker_thread(uint8_t idx) noexcept;
+        void create_dispatcher(uint8_t idx) noexcept;
+        void create_fibers(uint32_t ordinal, uint32_t sharers) noexcept;
+        void idle(uint8_t idx, uint32_t& iterations) noexcept;
+        bool has_work(uint8_t idx) noexcept;
+        bool next_task(uint8_t idx, np::fiber_base*& fiber) noexcept;
+        bool next_task(uint8_t idx, uint8_t stack_class, np::fiber_base* fiber) noexcept;
+        bool pending_tasks() noexcept;
+
+        // With lazy binding, the fiber handed off by the last task to end or else a newly bound one
+        bool next_started(uint8_t idx, np::fiber_base*& fiber, np::fiber_base*& handoff) noexcept;
+
+        // Queues a task that has no fiber yet
+        template <typename F>
+        void enqueue_task(F&& function, np::counter& counter, uint8_t stack_class, np::priority priority, uint8_t worker, std::chrono::steady_clock::time_point pushed_at) noexcept;
+        static void queue_stats(const fiber_pool_base* pool, pool_stats& stats) noexcept;
+
+        // Push time of sampled tasks, or the epoch for the rest
+        static inline std::chrono::steady_clock::time_point sample_push_time() noexcept;
+
+        // A released slot if there is any, a new one otherwise
+        detail::future_slot* acquire_future_slot() noexcept;
 
     protected:
-        bool get_free_fiber(np::fiber_base*& fiber) noexcept;
+        bool get_free_fiber(np::fiber_base*& fiber, uint8_t stack_class) noexcept;
+        np::fiber_base* create_fiber(uint8_t stack_class) noexcept;
 
     private:
-        moodycamel::ConcurrentQueue<task_bundle> _tasks;
+        std::array<moodycamel::ConcurrentQueue<np::fiber_base*>, number_of_stack_classes> _fibers;
+        std::array<std::array<moodycamel::ConcurrentQueue<task_bundle>, number_of_stack_classes>, detail::number_of_priorities> _tasks;
+        std::array<std::atomic<uint32_t>, number_of_stack_classes> _number_of_spawned_fibers_per_class;
+        // Tasks in _tasks of each stack class, so that workers don't go through every queue to find none
+        alignas(detail::cacheline_length) std::array<std::atomic<uint32_t>, number_of_stack_classes> _queued_tasks;
+        np::stack_profile _stack_profile;
+        detail::future_slot::free_slots_t _future_slots;
+        detail::task_slabs _task_slabs;
     };
 
 
@@ -194,6 +559,125 @@ namespace np
         unblock(fiber);
     }
 
+    inline void fiber_pool_base::resume(protected_access_t, std::coroutine_handle<> coroutine) noexcept
+    {
+        resume(coroutine);
+    }
+
+    inline void fiber_pool_base::add_timer(protected_access_t, detail::timer& timer) noexcept
+    {
+        add_timer(timer);
+    }
+
+    inline bool fiber_pool_base::remove_timer(protected_access_t, detail::timer& timer) noexcept
+    {
+        return _timers.remove(&timer);
+    }
+
+    inline void fiber_pool_base::add_timer(detail::timer& timer) noexcept
+    {
+        // Parked dispatchers may be waiting on a later deadline, or none at all
+        if (_timers.add(&timer))
+        {
+            notify_idle();
+        }
+    }
+
+    inline void fiber_pool_base::notify_idle() noexcept
+    {
+        if (_idle_park)
+        {
+            _idle.notify_one();
+
+            // The eventcount fenced already, see prepare_reactor_sleep
+            if (_reactor_sleepers.load(std::memory_order_relaxed))
+            {
+                wake_reactors(false);
+            }
+        }
+    }
+
+    inline void fiber_pool_base::notify_idle(std::size_t count) noexcept
+    {
+        if (_idle_park && count)
+        {
+            if (count > 1)
+            {
+                _idle.notify_all();
+            }
+            else
+            {
+                _idle.notify_one();
+            }
+
+            if (_reactor_sleepers.load(std::memory_order_relaxed))
+            {
+                wake_reactors(count > 1);
+            }
+        }
+    }
+
+    inline void fiber_pool_base::notify_worker(uint8_t worker_id) noexcept
+    {
+        if (_idle_park)
+        {
+            _idle.notify_all();
+
+            if (_reactor_sleepers.load(std::memory_order_relaxed))
+            {
+                wake_reactor(worker_id);
+            }
+        }
+    }
+
+    inline void fiber_pool_base::expire_timers() noexcept
+    {
+        if (_timers.empty())
+        {
+            return;
+        }
+
+        // The fiber may resume as soon as it is unblocked, and its timer with it
+        const auto now = detail::timer_queue::clock::now();
+        while (detail::timer* timer = _timers.pop_expired(now))
+        {
+            unblock(timer->fiber);
+        }
+    }
+
+    inline uint8_t fiber_pool_base::first_priority(uint8_t idx) const noexcept
+    {
+        const auto& picks = _priority_streaks[idx].picks;
+
+        uint8_t level = 0;
+        while (std::size_t(level) + 1 < detail::number_of_priorities && picks[level] >= _yield_priority)
+        {
+            ++level;
+        }
+
+        return level;
+    }
+
+    inline void fiber_pool_base::picked_priority(uint8_t idx, uint8_t level) noexcept
+    {
+        // Higher levels were either empty or yielded to us, their streak starts over
+        auto& picks = _priority_streaks[idx].picks;
+        for (uint8_t higher = 0; higher < level; ++higher)
+        {
+            picks[higher] = 0;
+        }
+
+        ++picks[level];
+    }
+
+    inline void fiber_pool_base::poll_reactor(uint8_t idx) noexcept
+    {
+        if (io::reactor* reactor = _reactors[idx].load(std::memory_order_relaxed))
+        {
+            poll_reactor(reactor);
+        }
+    }
+
     inline uint16_t fiber_pool_base::number_of_threads() const noexcept
     {
         return _number_of_threads;
@@ -203,6 +687,16 @@ namespace np
     {
         return _target_number_of_fibers;
     }
+
+    inline const std::vector<uint8_t>& fiber_pool_base::worker_ids() const noexcept
+    {
+        return _worker_ids;
+    }
+
+    inline uint8_t fiber_pool_base::main_worker_id() const noexcept
+    {
+        return _main_worker_id;
+    }
     
     template <typename T>
     std::array<T, 256>& fiber_pool_base::threadlocal_all() noexcept
@@ -219,189 +713,828 @@ namespace np
 
 
     template <typename traits>
-    fiber_pool<traits>::fiber_pool() noexcept :
-        fiber_pool_base(),
-        _tasks()
+    fiber_pool<traits>::fiber_pool() noexcept :
+        fiber_pool_base(),
+        _fibers(),
+        _tasks(),
+        _number_of_spawned_fibers_per_class(),
+        _queued_tasks(),
+        _stack_profile(),
+        _future_slots(),
+        _task_slabs(traits::task_storage_size)
+    {
+#if defined(NETPUNK_TAMASHII_LOG)
+        spdlog::trace("fiber_pool constructor called");
+#endif
+
+        _work_stealing = traits::work_stealing;
+        _idle_park = traits::idle_park;
+        _yield_priority = traits::yield_priority;
+        _queue_stats = &fiber_pool<traits>::queue_stats;
+    }
+
+    template <typename traits>
+    fiber_pool<traits>::~fiber_pool() noexcept
+    {  
+#ifndef NDEBUG
+        assert(_is_joined && "Pool went out of scope without being joined");
+#endif
+
+#if defined(NETPUNK_TAMASHII_LOG)
+        spdlog::trace("fiber_pool destructor called");
+#endif
+
+        for (auto& fibers : _fibers)
+        {
+            np::fiber_base* fiber_base;
+            while (fibers.try_dequeue(fiber_base))
+            {
+                auto fiber = reinterpret_cast<np::fiber<traits>*>(fiber_base);
+                delete fiber;
+            }
+        }
+
+        // If main thread did not join, we need to do cleanup now
+        if (!_with_main_thread)
+        {
+            _thread_ids[_main_worker_id] = {};
+            if (_this_thread_pool == this)
+            {
+                _this_thread_pool = nullptr;
+            }
+
+            auto fiber = reinterpret_cast<np::fiber<traits>*>(_dispatcher_fibers[_main_worker_id]);
+            delete fiber;
+        }
+
+        destroy_reactors();
+
+        // Futures must be gone by now, so every slot is back
+        detail::future_slot* slot;
+        while (_future_slots.try_dequeue(slot))
+        {
+            detail::future_slot::destroy(slot);
+        }
+
+        // All workers are gone, nobody can steal anymore
+        for (uint8_t worker_id : _worker_ids)
+        {
+            for (auto& local_fibers : _local_fibers[worker_id])
+            {
+                delete local_fibers;
+                local_fibers = nullptr;
+            }
+
+            delete _inboxes[worker_id];
+            _inboxes[worker_id] = nullptr;
+            delete _counters[worker_id];
+            _counters[worker_id] = nullptr;
+
+            release_worker_id(worker_id);
+        }
+    }
+
+    template <typename traits>
+    fiber_pool<traits>* fiber_pool<traits>::instance() noexcept
+    {
+        return reinterpret_cast<fiber_pool<traits>*>(detail::fiber_pool_instance);
+    }
+
+    template <typename traits>
+    void fiber_pool<traits>::start(uint16_t number_of_threads, bool with_main_thread, const np::worker_affinity& affinity) noexcept
+    {
+        if (number_of_threads == 0)
+        {
+            number_of_threads = affinity.empty() ? std::thread::hardware_concurrency() : uint16_t(affinity.size());
+        }
+
+        _number_of_threads = number_of_threads;
+        _target_number_of_fibers = 0;
+        for (const auto& stack_size_class : stack_size_classes)
+        {
+            _target_number_of_fibers += stack_size_class.maximum_fibers;
+        }
+
+        // Created below, or by pinned workers, each its own share, before anyone starts dispatching
+        if constexpr (traits::preemtive_fiber_creation)
+        {
+            for (uint8_t stack_class = 0; stack_class < number_of_stack_classes; ++stack_class)
+            {
+                const uint32_t maximum_fibers = stack_size_classes[stack_class].maximum_fibers;
+                _number_of_spawned_fibers += maximum_fibers;
+                _number_of_spawned_fibers_per_class[stack_class] = maximum_fibers;
+            }
+        }
+
+        _running = true;
+        _barrier.reset(number_of_threads);
+
+        // Assign every id before spawning anything, thieves walk the whole list of workers
+        //  Even if we don't want main thread execution, assign an id to the thread
+        for (int idx = 0; idx <= number_of_threads - int(with_main_thread); ++idx)
+        {
+            uint8_t worker_id = acquire_worker_id();
+            _dispatcher_fibers[worker_id] = nullptr;
+            _running_fibers[worker_id] = nullptr;
+            _worker_ids.push_back(worker_id);
+        }
+
+        _main_worker_id = _worker_ids.back();
+        _with_main_thread = with_main_thread;
+
+        // Dispatchers take the cpus in the order of their ids, the main worker being the last one
+        _pinned = !affinity.empty();
+        _numa = false;
+        for (uint16_t ordinal = 0; ordinal < number_of_threads; ++ordinal)
+        {
+            const uint8_t worker_id = _worker_ids[ordinal];
+            _worker_cpus[worker_id] = _pinned ? affinity[ordinal] : np::cpu_info{};
+            _numa = _numa || _worker_cpus[worker_id].node != _worker_cpus[_worker_ids.front()].node;
+        }
+
+        // The main worker keeps a dispatcher even if it doesn't run it
+        if (!with_main_thread)
+        {
+            create_dispatcher(_main_worker_id);
+        }
+
+        if constexpr (traits::preemtive_fiber_creation)
+        {
+            if (!_pinned)
+            {
+                create_fibers(0, 1);
+            }
+        }
+
+        // Only workers running a dispatcher own a deque, an inbox and counters, anyone else falls back to the shared queue
+        for (uint8_t worker_id : _worker_ids)
+        {
+            if (worker_id != _main_worker_id || with_main_thread)
+            {
+                _inboxes[worker_id] = new worker_inbox();
+                _counters[worker_id] = new detail::worker_counters();
+
+                if constexpr (traits::work_stealing)
+                {
+                    for (auto& local_fibers : _local_fibers[worker_id])
+                    {
+                        local_fibers = new np::spmc_queue<np::fiber_base>();
+                    }
+                }
+            }
+        }
+
+        // Execute in other threads
+        for (uint8_t worker_id : _worker_ids)
+        {
+            if (worker_id != _main_worker_id)
+            {
+                _worker_threads.emplace_back(&fiber_pool<traits>::worker_thread, this, worker_id);
+            }
+        }
+
+        // Execute in main thread
+        if (with_main_thread)
+        {
+            worker_thread(_main_worker_id);
+        }
+    }
+
+    template <typename traits>
+    void fiber_pool<traits>::enable_main_thread_calls_here() noexcept
+    {
+        for (uint8_t i = 0; i < _fiber_worker_id; ++i)
+        {
+            assert(_thread_ids[i] != std::this_thread::get_id() && "Only one pool can own the main thread");
+        }
+
+        _thread_ids[_main_worker_id] = std::this_thread::get_id();
+        _this_thread_index = _main_worker_id;
+        _this_thread_pool = this;
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function) noexcept
+    {
+        submit(std::forward<F>(function), *get_dummy_counter(), np::stack_class{}, np::priority::normal, detail::unpinned);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function, np::stack_class stack) noexcept
+    {
+        submit(std::forward<F>(function), *get_dummy_counter(), stack, np::priority::normal, detail::unpinned);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function, np::counter& counter) noexcept
+    {
+        push(std::forward<F>(function), counter, np::stack_class{});
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function, np::counter& counter, np::stack_class stack) noexcept
+    {
+        push(std::forward<F>(function), counter, stack, np::priority::normal);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function, np::priority priority) noexcept
+    {
+        submit(std::forward<F>(function), *get_dummy_counter(), np::stack_class{}, priority, detail::unpinned);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function, np::counter& counter, np::priority priority) noexcept
+    {
+        push(std::forward<F>(function), counter, np::stack_class{}, priority);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push(F&& function, np::counter& counter, np::stack_class stack, np::priority priority) noexcept
+    {
+        counter.increase(badge());
+        submit(std::forward<F>(function), counter, stack, priority, detail::unpinned);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push_to(uint8_t worker_id, F&& function) noexcept
+    {
+        submit(std::forward<F>(function), *get_dummy_counter(), np::stack_class{}, np::priority::normal, worker_id);
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push_to(uint8_t worker_id, F&& function, np::counter& counter) noexcept
+    {
+        push_to(worker_id, std::forward<F>(function), counter, np::stack_class{});
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push_to(uint8_t worker_id, F&& function, np::counter& counter, np::stack_class stack) noexcept
+    {
+        counter.increase(badge());
+        submit(std::forward<F>(function), counter, stack, np::priority::normal, worker_id);
+    }
+
+    template <typename traits>
+    template <typename R>
+    void fiber_pool<traits>::push_bulk(R&& range, np::counter& counter) noexcept
+    {
+        push_bulk(std::forward<R>(range), counter, np::stack_class{});
+    }
+
+    template <typename traits>
+    template <typename R>
+    void fiber_pool<traits>::push_bulk(R&& range, np::counter& counter, np::stack_class stack) noexcept
+    {
+        const auto count = static_cast<std::size_t>(std::ranges::distance(range));
+
+        // Callables in temporaries can be moved into the tasks
+        if constexpr (std::is_lvalue_reference_v<R>)
+        {
+            submit_bulk(std::ranges::begin(range), count, counter, stack, np::priority::normal, stack_site_of<std::ranges::range_value_t<R>>());
+        }
+        else
+        {
+            submit_bulk(std::make_move_iterator(std::ranges::begin(range)), count, counter, stack, np::priority::normal, stack_site_of<std::ranges::range_value_t<R>>());
+        }
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push_n(std::size_t n, F&& function, np::counter& counter) noexcept
+    {
+        push_n(n, std::forward<F>(function), counter, np::stack_class{});
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::push_n(std::size_t n, F&& function, np::counter& counter, np::stack_class stack) noexcept
+    {
+        using function_t = std::decay_t<F>;
+        const function_t& callable = function;
+        submit_bulk(detail::indexed_task_iterator<function_t>{ &callable, 0 }, n, counter, stack, np::priority::normal, stack_site_of<function_t>());
+    }
+
+    template <typename traits>
+    template <typename F>
+    auto fiber_pool<traits>::async(F&& function) noexcept
+    {
+        return async(std::forward<F>(function), np::stack_class{}, np::priority::normal);
+    }
+
+    template <typename traits>
+    template <typename F>
+    auto fiber_pool<traits>::async(F&& function, np::stack_class stack) noexcept
+    {
+        return async(std::forward<F>(function), stack, np::priority::normal);
+    }
+
+    template <typename traits>
+    template <typename F>
+    auto fiber_pool<traits>::async(F&& function, np::priority priority) noexcept
+    {
+        return async(std::forward<F>(function), np::stack_class{}, priority);
+    }
+
+    template <typename traits>
+    template <typename F>
+    auto fiber_pool<traits>::async(F&& function, np::stack_class stack, np::priority priority) noexcept
+    {
+        using result_t = std::decay_t<std::invoke_result_t<std::decay_t<F>&>>;
+        static_assert(detail::future_fits<result_t>(traits::future_storage_size), "Result does not fit in a future slot, increase future_storage_size");
+
+        detail::future_slot* slot = acquire_future_slot();
+        push([slot, function = std::forward<F>(function)]() mutable {
+            if constexpr (std::is_void_v<result_t>)
+            {
+                function();
+            }
+            else
+            {
+                new (slot->storage()) result_t(function());
+            }
+
+            slot->complete();
+        }, slot->counter, stack, priority);
+
+        return np::future<result_t>{ badge(), slot };
+    }
+
+    template <typename traits>
+    constexpr np::stack_class fiber_pool<traits>::stack_class_for(std::size_t stack_size) noexcept
+    {
+        uint8_t best = 0;
+        for (uint8_t stack_class = 1; stack_class < number_of_stack_classes; ++stack_class)
+        {
+            const std::size_t best_size = stack_size_classes[best].stack_size;
+            const std::size_t size = stack_size_classes[stack_class].stack_size;
+
+            if (best_size < stack_size ? size > best_size : (size >= stack_size && size < best_size))
+            {
+                best = stack_class;
+            }
+        }
+
+        return np::stack_class{ best };
+    }
+
+    template <typename traits>
+    np::stack_profile_report fiber_pool<traits>::stack_profile() const noexcept
+    {
+        return _stack_profile.report();
+    }
+
+    template <typename traits>
+    template <typename F>
+    const detail::stack_site* fiber_pool<traits>::stack_site_of() noexcept
+    {
+        if constexpr (traits::profile_stacks)
+        {
+            return detail::stack_site_of<std::decay_t<F>>();
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
+
+    template <typename traits>
+    template <typename F>
+    decltype(auto) fiber_pool<traits>::fit(F&& function) noexcept
+    {
+        using closure_t = std::decay_t<F>;
+
+        if constexpr (sizeof(closure_t) <= traits::inplace_function_size && alignof(std::max_align_t) % alignof(closure_t) == 0)
+        {
+            return std::forward<F>(function);
+        }
+        else if constexpr (sizeof(closure_t) <= traits::task_storage_size && alignof(closure_t) <= detail::cacheline_length)
+        {
+            // Blocks go back to whichever worker ran the task, which is usually the one pushing the next
+            uint8_t worker = detail::unpinned;
+            worker_index(worker);
+            closure_t* closure = new (_task_slabs.allocate(worker)) closure_t(std::forward<F>(function));
+
+            return [this, closure] {
+                (*closure)();
+                closure->~closure_t();
+
+                uint8_t worker = detail::unpinned;
+                worker_index(worker);
+                _task_slabs.deallocate(worker, closure);
+            };
+        }
+        else
+        {
+            closure_t* closure = new closure_t(std::forward<F>(function));
+
+            return [closure] {
+                (*closure)();
+                delete closure;
+            };
+        }
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::submit(F&& function, np::counter& counter, np::stack_class stack, np::priority priority, uint8_t worker) noexcept
+    {
+        const uint8_t stack_class = static_cast<uint8_t>(stack);
+        assert(stack_class < number_of_stack_classes && "Unknown stack size class");
+        assert(static_cast<uint8_t>(priority) < detail::number_of_priorities && "Unknown priority");
+        assert((worker == detail::unpinned || _inboxes[worker]) && "Tasks can only be pinned to workers running a dispatcher");
+
+        const auto pushed_at = sample_push_time();
+
+        // Whoever gets a fiber for it schedules it, its worker is woken then
+        np::fiber_base* fiber;
+        if ((traits::lazy_fiber_binding && worker == detail::unpinned) || !get_free_fiber(fiber, stack_class))
+        {
+            enqueue_task(std::forward<F>(function), counter, stack_class, priority, worker, pushed_at);
+            notify_idle();
+            return;
+        }
+
+        reinterpret_cast<np::fiber<traits>*>(fiber)->reset(fit(std::forward<F>(function)), counter);
+        fiber->_priority = priority;
+        fiber->_worker = worker;
+        fiber->_site = stack_site_of<F>();
+        fiber->_pushed_at = pushed_at;
+        schedule(fiber);
+
+        if (worker == detail::unpinned)
+        {
+            notify_idle();
+        }
+        else
+        {
+            notify_worker(worker);
+        }
+    }
+
+    template <typename traits>
+    template <typename F>
+    void fiber_pool<traits>::enqueue_task(F&& function, np::counter& counter, uint8_t stack_class, np::priority priority, uint8_t worker, std::chrono::steady_clock::time_point pushed_at) noexcept
+    {
+        // Counted before it is visible, so that the count never falls short
+        _queued_tasks[stack_class].fetch_add(1, std::memory_order_relaxed);
+        _tasks[static_cast<uint8_t>(priority)][stack_class].enqueue({
+            .counter = &counter,
+            .function = fit(std::forward<F>(function)),
+            .worker = worker,
+            .site = stack_site_of<F>(),
+            .pushed_at = pushed_at
+            });
+    }
+
+    template <typename traits>
+    template <typename It>
+    void fiber_pool<traits>::submit_bulk(It first, std::size_t count, np::counter& counter, np::stack_class stack, np::priority priority, const detail::stack_site* site) noexcept
+    {
+        const uint8_t stack_class = static_cast<uint8_t>(stack);
+        assert(stack_class < number_of_stack_classes && "Unknown stack size class");
+        assert(static_cast<uint8_t>(priority) < detail::number_of_priorities && "Unknown priority");
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        // Increase it once and upfront, tasks may start finishing before all of them are queued
+        counter.increase(badge(), count);
+
+        // All of them are pushed at once, sample them together
+        const auto pushed_at = sample_push_time();
+
+        // Take free fibers in chunks while there are any, lazily bound tasks don't need them
+        constexpr std::size_t chunk_size = 64;
+        np::fiber_base* fibers[chunk_size];
+        std::size_t scheduled = 0;
+        while (!traits::lazy_fiber_binding && scheduled < count)
+        {
+            const std::size_t wanted = std::min(chunk_size, count - scheduled);
+            std::size_t available = _fibers[stack_class].try_dequeue_bulk(fibers, wanted);
+
+            if constexpr (!traits::preemtive_fiber_creation)
+            {
+                while (available < wanted && get_free_fiber(fibers[available], stack_class))
+                {
+                    ++available;
+                }
+            }
+
+            for (std::size_t i = 0; i < available; ++i, ++first)
+            {
+                reinterpret_cast<np::fiber<traits>*>(fibers[i])->reset(fit(*first), counter);
+                fibers[i]->_priority = priority;
+                fibers[i]->_worker = detail::unpinned;
+                fibers[i]->_site = site;
+                fibers[i]->_pushed_at = pushed_at;
+            }
+
+            schedule_bulk(fibers, available);
+            notify_idle(available);
+            scheduled += available;
+
+            if (available < wanted)
+            {
+                break;
+            }
+        }
+
+        // The rest waits for fibers to be freed
+        if (scheduled < count)
+        {
+            _queued_tasks[stack_class].fetch_add(uint32_t(count - scheduled), std::memory_order_relaxed);
+            _tasks[static_cast<uint8_t>(priority)][stack_class].enqueue_bulk(task_bundle_iterator<It>{ this, std::move(first), &counter, site, pushed_at }, count - scheduled);
+
+            if constexpr (traits::lazy_fiber_binding)
+            {
+                notify_idle(count);
+            }
+            else
+            {
+                notify_idle();
+            }
+        }
+    }
+
+    template <typename traits>
+    bool fiber_pool<traits>::get_free_fiber(np::fiber_base*& fiber, uint8_t stack_class) noexcept
+    {
+        if (!_fibers[stack_class].try_dequeue(fiber))
+        {
+            if constexpr (traits::preemtive_fiber_creation)
+            {
+                return false;
+            }
+            else
+            {
+                if (++_number_of_spawned_fibers_per_class[stack_class] > stack_size_classes[stack_class].maximum_fibers)
+                {
+                    --_number_of_spawned_fibers_per_class[stack_class];
+                    return false;
+                }
+
+                ++_number_of_spawned_fibers;
+                fiber = create_fiber(stack_class);
+
+#if defined(NETPUNK_TAMASHII_LOG)
+                spdlog::trace("[-] FIBER {} CREATED", fiber->_id);
+#endif
+            }
+        }
+
+        return true;
+    }
+
+    template <typename traits>
+    np::fiber_base* fiber_pool<traits>::create_fiber(uint8_t stack_class) noexcept
+    {
+        const uint32_t stack_size = stack_size_classes[stack_class].stack_size;
+
+#if defined(NDEBUG)
+        np::fiber_base* fiber = new np::fiber<traits>(stack_size, empty_fiber_t{});
+#else
+        np::fiber_base* fiber = new np::fiber<traits>(stack_size, &detail::invalid_fiber_guard);
+#endif
+
+        fiber->_stack_class = stack_class;
+
+        // Stacks are mapped lazily, so in pools spanning nodes their pages would land on the node of whichever
+        //  worker first runs deep into them. Commit them here instead, painting already touches all of them
+        if constexpr (traits::profile_stacks)
+        {
+            detail::paint_stack(fiber->_stack);
+        }
+        else if (_numa)
+        {
+            detail::prefault_stack(fiber->_stack);
+        }
+
+        return fiber;
+    }
+
+    template <typename traits>
+    bool fiber_pool<traits>::next_task(uint8_t idx, np::fiber_base*& fiber) noexcept
     {
-#if defined(NETPUNK_TAMASHII_LOG)
-        spdlog::trace("fiber_pool constructor called");
-#endif
-
-        if constexpr (traits::preemtive_fiber_creation)
+        for (uint8_t stack_class = 0; stack_class < number_of_stack_classes; ++stack_class)
         {
-            np::fiber_base** fibers = new np::fiber_base * [traits::maximum_fibers];
-            for (uint32_t i = 0; i < traits::maximum_fibers; ++i)
+            // Early out before touching the fibers queue
+            if (_queued_tasks[stack_class].load(std::memory_order_relaxed) == 0)
             {
+                continue;
+            }
 
-#if defined(NDEBUG)
-                fibers[i] = new np::fiber<traits>(traits::fiber_stack_size, empty_fiber_t{});
-#else
-                fibers[i] = new np::fiber<traits>(traits::fiber_stack_size, &detail::invalid_fiber_guard);
+            // Enqueueing and dequeueing a fiber is easier than a task, go that way
+            //  Lazily bound tasks are all queued, so fibers may have to be created here
+            bool free_fiber;
+            if constexpr (traits::lazy_fiber_binding)
+            {
+                free_fiber = get_free_fiber(fiber, stack_class);
+            }
+            else
+            {
+                free_fiber = _fibers[stack_class].try_dequeue(fiber);
+            }
+
+            if (!free_fiber)
+            {
+#ifdef TAMASHII_INTERNAL_FIBER_POOL_TRACK_BLOCKED
+                if (_number_of_blocked_fibers == _number_of_spawned_fibers)
+                {
+                    ++_number_of_spawned_fibers;
+                    ++_number_of_spawned_fibers_per_class[stack_class];
+                    spdlog::critical("fiber_pool ran out of fibers, increase maximum spawn to {}", _number_of_spawned_fibers);
+                    fiber = create_fiber(stack_class);
+                }
+                else
 #endif
+                {
+                    continue;
+                }
             }
 
-            _number_of_spawned_fibers = traits::maximum_fibers;
-            _fibers.enqueue_bulk(fibers, traits::maximum_fibers);
-            delete[] fibers;
+            // We had a fiber and a task!
+            if (next_task(idx, stack_class, fiber))
+            {
+                return true;
+            }
+
+            _fibers[stack_class].enqueue(fiber);
         }
+
+        return false;
     }
 
     template <typename traits>
-    fiber_pool<traits>::~fiber_pool() noexcept
-    {  
-#ifndef NDEBUG
-        assert(_is_joined && "Pool went out of scope without being joined");
-#endif
-
-#if defined(NETPUNK_TAMASHII_LOG)
-        spdlog::trace("fiber_pool destructor called");
-#endif
-
-        np::fiber_base* fiber_base;
-        while (_fibers.try_dequeue(fiber_base))
+    bool fiber_pool<traits>::next_task(uint8_t idx, uint8_t stack_class, np::fiber_base* fiber) noexcept
+    {
+        if (_queued_tasks[stack_class].load(std::memory_order_relaxed) == 0)
         {
-            auto fiber = reinterpret_cast<np::fiber<traits>*>(fiber_base);
-            delete fiber;
+            return false;
         }
 
-        // If main thread did not join, we need to do cleanup now
-        if (!_with_main_thread)
+        // Same order as awaiting fibers, but only those count towards a priority's streak
+        const uint8_t first = first_priority(idx);
+        for (uint8_t i = 0; i < detail::number_of_priorities; ++i)
         {
-            _thread_ids[_main_worker_id] = {};
-            auto fiber = reinterpret_cast<np::fiber<traits>*>(_dispatcher_fibers[_main_worker_id]);
-            delete fiber;
+            const uint8_t level = uint8_t((first + i) % detail::number_of_priorities);
+
+            task_bundle task;
+            if (_tasks[level][stack_class].try_dequeue(task))
+            {
+                _queued_tasks[stack_class].fetch_sub(1, std::memory_order_relaxed);
+                reinterpret_cast<np::fiber<traits>*>(fiber)->reset(std::move(task.function), *task.counter);
+                fiber->_priority = np::priority{ level };
+                fiber->_worker = task.worker;
+                fiber->_site = task.site;
+                fiber->_pushed_at = task.pushed_at;
+                return true;
+            }
         }
+
+        return false;
     }
 
     template <typename traits>
-    fiber_pool<traits>* fiber_pool<traits>::instance() noexcept
+    detail::future_slot* fiber_pool<traits>::acquire_future_slot() noexcept
     {
-        return reinterpret_cast<fiber_pool<traits>*>(detail::fiber_pool_instance);
+        detail::future_slot* slot;
+        if (_future_slots.try_dequeue(slot))
+        {
+            return slot;
+        }
+
+        // Only until there are as many slots as futures ever alive at once
+        return detail::future_slot::create(&_future_slots, traits::future_storage_size);
     }
 
     template <typename traits>
-    void fiber_pool<traits>::start(uint16_t number_of_threads, bool with_main_thread) noexcept
+    inline std::chrono::steady_clock::time_point fiber_pool<traits>::sample_push_time() noexcept
     {
-        if (number_of_threads == 0)
+        // Counted per pushing thread, a shared counter would be contended by every submit
+        if constexpr (traits::wait_time_sampling == 0)
         {
-            number_of_threads = std::thread::hardware_concurrency();
+            return {};
         }
+        else
+        {
+            if (count_push() % traits::wait_time_sampling != 0)
+            {
+                return {};
+            }
 
-        _number_of_threads = number_of_threads;
-        _target_number_of_fibers = traits::maximum_fibers;
+            return std::chrono::steady_clock::now();
+        }
+    }
 
-        _running = true;
-        _barrier.reset(number_of_threads);
+    template <typename traits>
+    void fiber_pool<traits>::queue_stats(const fiber_pool_base* pool, pool_stats& stats) noexcept
+    {
+        const auto* self = static_cast<const fiber_pool<traits>*>(pool);
 
-        // Execute in other threads
-        for (int idx = int(with_main_thread); idx < number_of_threads; ++idx)
+        for (const auto& level : self->_tasks)
         {
-            // Set dispatcher fiber
-            uint8_t worker_id = _fiber_worker_id++;
-            _dispatcher_fibers[worker_id] = new np::fiber<traits>("Dispatcher/%d", traits::fiber_stack_size, empty_fiber_t{});
-            _dispatcher_fibers[worker_id]->set_fiber_pool(badge(), this);
-            _running_fibers[worker_id] = _dispatcher_fibers[worker_id];
-            _worker_threads.emplace_back(&fiber_pool<traits>::worker_thread, this, worker_id);
+            for (const auto& tasks : level)
+            {
+                stats.pending_tasks += tasks.size_approx();
+            }
         }
 
-        // Even if we don't want main thread execution, assign an id to the thread
-        _main_worker_id = _fiber_worker_id++;
-        _dispatcher_fibers[_main_worker_id] = new np::fiber<traits>("Dispatcher/%d", traits::fiber_stack_size, empty_fiber_t{});
-        _dispatcher_fibers[_main_worker_id]->set_fiber_pool(badge(), this);
-        _running_fibers[_main_worker_id] = _dispatcher_fibers[_main_worker_id];
-
-        // Execute in main thread
-        _with_main_thread = with_main_thread;
-        if (with_main_thread)
+        for (const auto& fibers : self->_fibers)
         {
-            worker_thread(_main_worker_id);
+            stats.free_fibers += fibers.size_approx();
         }
     }
 
     template <typename traits>
-    void fiber_pool<traits>::enable_main_thread_calls_here() noexcept
+    bool fiber_pool<traits>::pending_tasks() noexcept
     {
-        for (uint8_t i = 0; i < _fiber_worker_id; ++i)
+        for (auto& queued : _queued_tasks)
         {
-            assert(_thread_ids[i] != std::this_thread::get_id() && "Only one pool can own the main thread");
+            if (queued.load(std::memory_order_relaxed) != 0)
+            {
+                return true;
+            }
         }
 
-        _thread_ids[_main_worker_id] = std::this_thread::get_id();
+        return false;
     }
 
     template <typename traits>
-    template <typename F>
-    void fiber_pool<traits>::push(F&& function) noexcept
+    bool fiber_pool<traits>::next_started(uint8_t idx, np::fiber_base*& fiber, np::fiber_base*& handoff) noexcept
     {
-        np::fiber_base* fiber;
-        if (!get_free_fiber(fiber))
+        if (handoff)
         {
-            _tasks.enqueue({
-                .counter = get_dummy_counter(),
-                .function = std::forward<F>(function)
-                });
-            return;
+            fiber = std::exchange(handoff, nullptr);
+            return true;
         }
 
-        reinterpret_cast<np::fiber<traits>*>(fiber)->reset(std::forward<F>(function));
-        _awaiting_fibers.enqueue(fiber);
+        return next_task(idx, fiber);
     }
 
     template <typename traits>
-    template <typename F>
-    void fiber_pool<traits>::push(F&& function, np::counter& counter) noexcept
+    void fiber_pool<traits>::create_dispatcher(uint8_t idx) noexcept
     {
-        counter.increase(badge());
-
-        np::fiber_base* fiber;
-        if (!get_free_fiber(fiber))
-        {
-            _tasks.enqueue({
-                .counter = &counter,
-                .function = std::forward<F>(function)
-                });
-            return;
-        }
-
-        reinterpret_cast<np::fiber<traits>*>(fiber)->reset(std::forward<F>(function), counter);
-        _awaiting_fibers.enqueue(fiber);
+        _dispatcher_fibers[idx] = new np::fiber<traits>("Dispatcher/%d", traits::fiber_stack_size, empty_fiber_t{});
+        _dispatcher_fibers[idx]->set_fiber_pool(badge(), this);
+        _running_fibers[idx] = _dispatcher_fibers[idx];
     }
 
     template <typename traits>
-    bool fiber_pool<traits>::get_free_fiber(np::fiber_base*& fiber) noexcept
+    void fiber_pool<traits>::create_fibers(uint32_t ordinal, uint32_t sharers) noexcept
     {
-        if (!_fibers.try_dequeue(fiber))
+        for (uint8_t stack_class = 0; stack_class < number_of_stack_classes; ++stack_class)
         {
-            if constexpr (traits::preemtive_fiber_creation)
+            const uint32_t maximum_fibers = stack_size_classes[stack_class].maximum_fibers;
+            const uint32_t share = maximum_fibers / sharers + uint32_t(ordinal < maximum_fibers % sharers);
+            if (share == 0)
             {
-                return false;
+                continue;
             }
-            else
-            {
-                if (++_number_of_spawned_fibers > traits::maximum_fibers)
-                {
-                    _number_of_spawned_fibers = traits::maximum_fibers;
-                    return false;
-                }
-
-#if defined(NDEBUG)
-                fiber = new np::fiber<traits>(traits::fiber_stack_size, empty_fiber_t{});
-#else
-                fiber = new np::fiber<traits>(traits::fiber_stack_size, &detail::invalid_fiber_guard);
-#endif
 
-#if defined(NETPUNK_TAMASHII_LOG)
-                spdlog::trace("[-] FIBER {} CREATED", fiber->_id);
-#endif
+            np::fiber_base** fibers = new np::fiber_base * [share];
+            for (uint32_t i = 0; i < share; ++i)
+            {
+                fibers[i] = create_fiber(stack_class);
             }
-        }
 
-        return true;
+            _fibers[stack_class].enqueue_bulk(fibers, share);
+            delete[] fibers;
+        }
     }
 
     template <typename traits>
     void fiber_pool<traits>::worker_thread(uint8_t idx) noexcept
     {
+        // Pin before allocating anything, memory is placed on the node of whoever touches it first
+        if (_pinned)
+        {
+            detail::pin_this_thread(_worker_cpus[idx].cpu);
+        }
+
+        create_dispatcher(idx);
+
+        // Dispatchers come first in the list of ids, in the same order they took their cpus
+        if constexpr (traits::preemtive_fiber_creation)
+        {
+            if (_pinned)
+            {
+                create_fibers(uint32_t(std::find(_worker_ids.begin(), _worker_ids.end(), idx) - _worker_ids.begin()), _number_of_threads);
+            }
+        }
+
         plDeclareThreadDyn("Workers/%d", idx);
         plAttachVirtualThread(_dispatcher_fibers[idx]->_id);
 
@@ -411,10 +1544,22 @@ namespace np
 
         // Thread data
         _thread_ids[idx] = std::this_thread::get_id();
+        _this_thread_index = idx;
+        _this_thread_pool = this;
 
         // Wait for all threads
         _barrier.wait();
 
+        detail::worker_counters& counters = *_counters[idx];
+
+        // Consecutive loops without running anything
+        uint32_t idle_iterations = 0;
+
+        // With lazy binding, the fiber of the last task to end already bound to the next one, and whether
+        //  starting tasks or awaiting fibers go first on the next loop
+        np::fiber_base* handoff = nullptr;
+        bool tasks_turn = false;
+
         // Keep on getting tasks and running them
         while (true)
         {
@@ -424,8 +1569,23 @@ namespace np
             // Temporal to hold an enqueued fiber
             np::fiber_base* fiber;
 
+            // Sleeping fibers whose time has come go back to the run queues, as do those whose I/O completed
+            expire_timers();
+            poll_reactor(idx);
+
+            // At most one task per loop, so that fibers keep getting their turn
+            const bool resumed = resume_coroutine(idx);
+
+            // New tasks take turns with awaiting fibers, otherwise yielding fibers could keep them from ever starting
+            bool started = false;
+            if constexpr (traits::lazy_fiber_binding)
+            {
+                tasks_turn = !tasks_turn;
+                started = tasks_turn && next_started(idx, fiber, handoff);
+            }
+
             // Get a free fiber from the pool
-            if (!_awaiting_fibers.try_dequeue(fiber))
+            if (!started && !next_awaiting(idx, fiber))
             {
 #if defined(NETPUNK_TAMASHII_PALANTEER_INTERNAL) && NETPUNK_TAMASHII_PALANTEER_INTERNAL >= 2
                 plScope("Dispatcher cold");
@@ -439,48 +1599,43 @@ namespace np
 #endif
 #endif // NETPUNK_SPINLOCK_PAUSE
 
-                // Try to get a new task without assigned fiber
-                // But first try an early out
-                if (_tasks.size_approx() == 0)
+                // Try to get a new task without assigned fiber, lazily bound ones start right here
+                if constexpr (traits::lazy_fiber_binding)
                 {
-                    // Exit pool if it is not running anymore
-                    if (!_running)
-                    {
-                        break;
-                    }
-
+                    started = next_started(idx, fiber, handoff);
+                }
+                else if (next_task(idx, fiber))
+                {
+                    schedule(fiber);
                     continue;
                 }
 
-                // Enqueueing and dequeueing a fiber is easier than a task, go that way
-                if (!_fibers.try_dequeue(fiber))
+                if (!started)
                 {
-#ifdef TAMASHII_INTERNAL_FIBER_POOL_TRACK_BLOCKED
-                    if (_number_of_blocked_fibers == _number_of_spawned_fibers)
+                    if (resumed)
                     {
-                        ++_number_of_spawned_fibers;
-                        spdlog::critical("fiber_pool ran out of fibers, increase maximum spawn to {}", _number_of_spawned_fibers);
-#if defined(NDEBUG)
-                        fiber = new np::fiber<traits>(traits::fiber_stack_size, empty_fiber_t{});
-#else
-                        fiber = new np::fiber<traits>(traits::fiber_stack_size, &detail::invalid_fiber_guard);
-#endif
+                        idle_iterations = 0;
+                        continue;
                     }
-                    else
-#endif
-                    continue;
-                }
 
-                task_bundle task;
-                if (!_tasks.try_dequeue(task))
-                {
-                    _fibers.enqueue(fiber);
+                    // Exit pool if it is not running anymore
+                    if (!_running && !pending_tasks() && _coroutines.size_approx() == 0)
+                    {
+                        break;
+                    }
+
+                    idle(idx, idle_iterations);
                     continue;
                 }
+            }
 
-                // We had a fiber and a task!
-                reinterpret_cast<np::fiber<traits>*>(fiber)->reset(std::move(task.function), *task.counter);
-                _awaiting_fibers.enqueue(std::move(fiber));
+            idle_iterations = 0;
+
+            // Tasks pinned to some other worker were queued when there were no fibers, they go to their worker
+            if (started && fiber->_worker != detail::unpinned && fiber->_worker != idx)
+            {
+                schedule(fiber);
+                notify_worker(fiber->_worker);
                 continue;
             }
 
@@ -488,10 +1643,24 @@ namespace np
             //  that is the case
             if (fiber->execution_status(badge()) != fiber_execution_status::ready)
             {
-                _awaiting_fibers.enqueue(fiber);
+                schedule(fiber);
                 continue;
             }
 
+            detail::bump(counters.dispatches);
+            if (fiber->status() == fiber_status::initialized)
+            {
+                detail::bump(counters.tasks_started);
+                if (fiber->_pushed_at != std::chrono::steady_clock::time_point{})
+                {
+                    counters.wait(std::chrono::steady_clock::now() - fiber->_pushed_at);
+                }
+            }
+            else if (fiber->status() == fiber_status::blocked)
+            {
+                detail::bump(counters.unblocks);
+            }
+
 #if defined(NETPUNK_TAMASHII_LOG)
             spdlog::trace("[{}] FIBER {}/{} EXECUTE", idx, fiber->_id, fiber->status());
 #endif
@@ -517,19 +1686,37 @@ namespace np
             {
                 case fiber_status::ended:
                 {
+                    detail::bump(counters.tasks_ended);
+
+                    // Nothing runs on its stack anymore, measure it before the next task goes on it
+                    if constexpr (traits::profile_stacks)
+                    {
+                        _stack_profile.record(fiber->_site, detail::stack_high_water_mark(fiber->_stack));
+                    }
+
 #if defined(NETPUNK_TAMASHII_PALANTEER_INTERNAL) && NETPUNK_TAMASHII_PALANTEER_INTERNAL >= 3
                     plBegin("Dispatcher pop task");
 #endif
 
-                    task_bundle task;
-                    if (_tasks.try_dequeue(task))
+                    if constexpr (traits::lazy_fiber_binding)
+                    {
+                        // Its stack is still warm, keep it on this worker for the next task
+                        if (!handoff && next_task(idx, fiber->_stack_class, fiber))
+                        {
+                            handoff = fiber;
+                        }
+                        else
+                        {
+                            _fibers[fiber->_stack_class].enqueue(std::move(fiber));
+                        }
+                    }
+                    else if (next_task(idx, fiber->_stack_class, fiber))
                     {
-                        reinterpret_cast<np::fiber<traits>*>(fiber)->reset(std::move(task.function), *task.counter);
-                        _awaiting_fibers.enqueue(std::move(fiber));
+                        schedule(fiber);
                     }
                     else
                     {
-                        _fibers.enqueue(std::move(fiber));
+                        _fibers[fiber->_stack_class].enqueue(std::move(fiber));
                     }
 
 #if defined(NETPUNK_TAMASHII_PALANTEER_INTERNAL) && NETPUNK_TAMASHII_PALANTEER_INTERNAL >= 3
@@ -539,11 +1726,13 @@ namespace np
                 break;
 
                 case fiber_status::yielded:
+                    detail::bump(counters.yields);
+
 #if defined(NETPUNK_TAMASHII_PALANTEER_INTERNAL) && NETPUNK_TAMASHII_PALANTEER_INTERNAL >= 3
                     plBegin("Dispatcher push awaiting");
 #endif
 
-                    _awaiting_fibers.enqueue(std::move(fiber));
+                    schedule(fiber);
 
 #if defined(NETPUNK_TAMASHII_PALANTEER_INTERNAL) && NETPUNK_TAMASHII_PALANTEER_INTERNAL >= 3
                     plEnd("Dispatcher push awaiting");
@@ -551,6 +1740,8 @@ namespace np
                     break;
 
                 case fiber_status::blocked:
+                    detail::bump(counters.blocks);
+
 #ifdef TAMASHII_INTERNAL_FIBER_POOL_TRACK_BLOCKED
                     ++_number_of_blocked_fibers;
 #endif
@@ -577,16 +1768,138 @@ namespace np
 
         // Clean up this thread id
         _thread_ids[idx] = {};
+        _this_thread_pool = nullptr;
         
         // Delete dispatcher fiber
         auto fiber = reinterpret_cast<np::fiber<traits>*>(_dispatcher_fibers[idx]);
         delete fiber;
     }
 
+    template <typename traits>
+    void fiber_pool<traits>::idle(uint8_t idx, uint32_t& iterations) noexcept
+    {
+        constexpr uint64_t yield_threshold = uint64_t(traits::idle_spin_iterations);
+        constexpr uint64_t park_threshold = yield_threshold + traits::idle_yield_iterations;
+
+        detail::worker_counters& counters = *_counters[idx];
+        detail::bump(counters.idle_spins);
+
+        if (iterations < yield_threshold)
+        {
+            ++iterations;
+            return;
+        }
+
+        if (!traits::idle_park || iterations < park_threshold)
+        {
+            iterations += iterations < park_threshold;
+            std::this_thread::yield();
+            return;
+        }
+
+        // Completions only show up in the reactor, so sleep there if there is anything in flight
+        if (io::reactor* reactor = busy_reactor(idx))
+        {
+            prepare_reactor_sleep(reactor);
+            if (!_running || has_work(idx))
+            {
+                cancel_reactor_sleep(reactor);
+                return;
+            }
+
+            detail::bump(counters.parks);
+            reactor_sleep(reactor);
+            return;
+        }
+
+        // Anything pushed after prepare_wait will wake us, anything before is seen by has_work
+        //  Timers added after it wake us too, so that we sleep until the new earliest deadline
+        uint32_t key = _idle.prepare_wait();
+        if (!_running || has_work(idx))
+        {
+            _idle.cancel_wait();
+            return;
+        }
+
+        detail::bump(counters.parks);
+        if (_timers.empty())
+        {
+            _idle.wait(key);
+        }
+        else
+        {
+            _idle.wait_until(key, _timers.next_deadline());
+        }
+    }
+
+    template <typename traits>
+    bool fiber_pool<traits>::has_work(uint8_t idx) noexcept
+    {
+        // Other workers' inboxes are none of our business, their owners are woken for them
+        if (_inboxes[idx] && _inboxes[idx]->pending.load(std::memory_order_relaxed) != 0)
+        {
+            return true;
+        }
+
+        for (auto& awaiting_fibers : _awaiting_fibers)
+        {
+            if (awaiting_fibers.size_approx() != 0)
+            {
+                return true;
+            }
+        }
+
+        if (_coroutines.size_approx() != 0)
+        {
+            return true;
+        }
+
+        if (!_timers.empty() && _timers.next_deadline() <= detail::timer_queue::clock::now())
+        {
+            return true;
+        }
+
+        // Tasks can't run until some fiber is free, and whoever frees it picks the task on its own
+        //  Lazily bound ones may also get a fiber created for them
+        for (uint8_t stack_class = 0; stack_class < number_of_stack_classes; ++stack_class)
+        {
+            if (_queued_tasks[stack_class].load(std::memory_order_relaxed) != 0)
+            {
+                if (_fibers[stack_class].size_approx() != 0)
+                {
+                    return true;
+                }
+
+                if constexpr (traits::lazy_fiber_binding && !traits::preemtive_fiber_creation)
+                {
+                    if (_number_of_spawned_fibers_per_class[stack_class] < stack_size_classes[stack_class].maximum_fibers)
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        for (uint8_t worker_id : _worker_ids)
+        {
+            for (auto local_fibers : _local_fibers[worker_id])
+            {
+                if (local_fibers && !local_fibers->empty())
+                {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
     template <typename traits>
     void fiber_pool<traits>::end() noexcept
     {
         _running = false;
+        _idle.notify_all();
+        wake_reactors(true);
     }
 
     template <typename traits>
@@ -623,6 +1936,34 @@ namespace np
             this_fiber::fiber_pool()->yield();
         }
 
+        template <typename clock, typename duration>
+        inline void sleep_until(const std::chrono::time_point<clock, duration>& deadline) noexcept
+        {
+            assert(this_fiber::fiber_pool() && "Must be called inside a fiber");
+
+            using steady_clock = std::chrono::steady_clock;
+            if constexpr (std::is_same_v<clock, steady_clock>)
+            {
+                this_fiber::fiber_pool()->sleep_until(std::chrono::ceil<steady_clock::duration>(deadline));
+            }
+            else
+            {
+                this_fiber::fiber_pool()->sleep_until(steady_clock::now() + std::chrono::ceil<steady_clock::duration>(deadline - clock::now()));
+            }
+        }
+
+        template <typename rep, typename period>
+        inline void sleep_for(const std::chrono::duration<rep, period>& duration) noexcept
+        {
+            sleep_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+        }
+
+        inline void set_sticky(bool sticky) noexcept
+        {
+            assert(this_fiber::fiber_pool() && "Must be called inside a fiber");
+            this_fiber::fiber_pool()->set_sticky(sticky);
+        }
+
         template <typename T, typename... Args>
         inline T& threadlocal(Args&&... args) noexcept
         {
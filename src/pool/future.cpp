@@ -0,0 +1,94 @@
+#include "pool/future.hpp"
+
+
+namespace np
+{
+    namespace detail
+    {
+        future_watch::future_watch() noexcept :
+            _fired(false),
+            _pending()
+        {
+            // Like a task pushed along it, done by whoever notifies first
+            _pending._state.store(1, std::memory_order_relaxed);
+        }
+
+        void future_watch::notify() noexcept
+        {
+            if (!_fired.exchange(true, std::memory_order_acq_rel))
+            {
+                _pending.done_impl(nullptr);
+            }
+        }
+
+        void future_watch::wait() noexcept
+        {
+            _pending.wait();
+        }
+
+        future_slot::future_slot(free_slots_t* free_slots) noexcept :
+            counter(),
+            _lock(false),
+            _ready(false),
+            _watch(nullptr),
+            _free_slots(free_slots)
+        {}
+
+        future_slot* future_slot::create(free_slots_t* free_slots, std::size_t storage_size) noexcept
+        {
+            void* memory = ::operator new(sizeof(future_slot) + storage_size, std::align_val_t(alignof(future_slot)));
+            return new (memory) future_slot(free_slots);
+        }
+
+        void future_slot::destroy(future_slot* slot) noexcept
+        {
+            slot->~future_slot();
+            ::operator delete(slot, std::align_val_t(alignof(future_slot)));
+        }
+
+        void future_slot::complete() noexcept
+        {
+            // Watchers unwatch under the lock, so the watch can't go away while notifying it
+            lock();
+            _ready.store(true, std::memory_order_release);
+            if (_watch)
+            {
+                _watch->notify();
+            }
+            unlock();
+        }
+
+        bool future_slot::watch(future_watch* watch) noexcept
+        {
+            lock();
+            if (_ready.load(std::memory_order_relaxed))
+            {
+                unlock();
+                return false;
+            }
+
+            assert(_watch == nullptr && "Futures can only be in one when_any at a time");
+            _watch = watch;
+            unlock();
+            return true;
+        }
+
+        void future_slot::unwatch() noexcept
+        {
+            lock();
+            _watch = nullptr;
+            unlock();
+        }
+
+        void future_slot::release() noexcept
+        {
+            // The next async re-arms the counter, whoever completed it must be done with it by then
+            //  Waits return only once that is the case, this one is cheap after get or reset already waited
+            counter.wait();
+            assert((counter._state.load(std::memory_order_acquire) & np::counter::waiters_flag) == 0 && "Released a future slot whose counter is still waking waiters");
+
+            _ready.store(false, std::memory_order_relaxed);
+            _free_slots->enqueue(this);
+        }
+    }
+}
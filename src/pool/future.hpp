@@ -0,0 +1,363 @@
+#pragma once
+
+#include "synchronization/counter.hpp"
+#include "utils/badge.hpp"
+#include "utils/cacheline.hpp"
+
+#include <concurrentqueue.h>
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+
+namespace np
+{
+    class fiber_pool_base;
+
+    template <typename T>
+    class future;
+
+    namespace detail
+    {
+        class future_slot;
+
+        // Wakes whoever waits in when_any, only the first future to complete does
+        class future_watch
+        {
+        public:
+            future_watch() noexcept;
+
+            void notify() noexcept;
+            void wait() noexcept;
+
+        private:
+            std::atomic<bool> _fired;
+            np::counter _pending;
+        };
+
+        // Where a future's result lives, followed by the pool's future_storage_size bytes of storage
+        //  Pools keep released slots around and hand them to later async calls, so that only the first
+        //  ones allocate
+        class alignas(cacheline_length) future_slot
+        {
+        public:
+            using free_slots_t = moodycamel::ConcurrentQueue<future_slot*>;
+
+            static future_slot* create(free_slots_t* free_slots, std::size_t storage_size) noexcept;
+            static void destroy(future_slot* slot) noexcept;
+
+            inline void* storage() noexcept;
+            inline bool ready() const noexcept;
+
+            // Called by the task once the result is stored, the counter is done right after
+            void complete() noexcept;
+
+            // False if already complete, otherwise the watch is notified when it is
+            bool watch(future_watch* watch) noexcept;
+            void unwatch() noexcept;
+
+            // Back to the pool's free slots, the result must have been destroyed
+            void release() noexcept;
+
+        public:
+            np::counter counter;
+
+        private:
+            explicit future_slot(free_slots_t* free_slots) noexcept;
+
+            inline void lock() noexcept;
+            inline void unlock() noexcept;
+
+        private:
+            std::atomic<bool> _lock;
+            std::atomic<bool> _ready;
+            future_watch* _watch;
+            free_slots_t* _free_slots;
+        };
+
+        // Whether a result of type T can be stored in slots of storage_size bytes
+        template <typename T>
+        constexpr bool future_fits(std::size_t storage_size) noexcept
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                return true;
+            }
+            else
+            {
+                return sizeof(T) <= storage_size && alignof(T) <= alignof(future_slot);
+            }
+        }
+
+        // Everything but the result, which depends on the future's type
+        class future_base
+        {
+            friend struct future_access;
+
+        public:
+            inline bool valid() const noexcept;
+
+            // Never blocks, true once the task returned
+            inline bool ready() const noexcept;
+
+            // Parks the calling fiber, or thread, until the task returns
+            inline void wait() noexcept;
+
+            // Only from tasks, as in co_await future.wait_async()
+            inline np::counter::wait_awaiter wait_async() noexcept;
+
+        protected:
+            future_base() noexcept = default;
+            explicit future_base(detail::future_slot* slot) noexcept;
+
+            future_base(future_base&& other) noexcept;
+
+            ~future_base() noexcept = default;
+
+        protected:
+            detail::future_slot* _slot = nullptr;
+        };
+
+        struct future_access
+        {
+            static future_slot* slot(future_base& future) noexcept { return future._slot; }
+            static future_slot* slot(future_base* future) noexcept { return future->_slot; }
+        };
+    }
+
+    // Result of a task pushed with fiber_pool::async, stored inline in a slot of its pool
+    //  Futures that go out of scope before their task returns wait for it, as std::async ones do, and
+    //  all of them must be gone before the pool is destroyed
+    template <typename T>
+    class future : public detail::future_base
+    {
+    public:
+        future() noexcept = default;
+        future(::badge<fiber_pool_base>, detail::future_slot* slot) noexcept;
+
+        future(const future&) = delete;
+        future& operator=(const future&) = delete;
+
+        future(future&& other) noexcept = default;
+        future& operator=(future&& other) noexcept;
+
+        ~future() noexcept;
+
+        // Waits for the result and moves it out, the future is no longer valid afterwards
+        T get() noexcept;
+
+    private:
+        void reset() noexcept;
+    };
+
+    // Parks the caller until every future is ready
+    template <typename... T>
+    void when_all(future<T>&... futures) noexcept;
+
+    template <typename R> requires std::ranges::range<R>
+    void when_all(R&& futures) noexcept;
+
+    // Parks the caller until any future is ready, and returns the index of the first ready one
+    template <typename... T>
+    std::size_t when_any(future<T>&... futures) noexcept;
+
+    template <typename R> requires std::ranges::range<R>
+    std::size_t when_any(R&& futures) noexcept;
+
+
+    namespace detail
+    {
+        inline void* future_slot::storage() noexcept
+        {
+            return this + 1;
+        }
+
+        inline bool future_slot::ready() const noexcept
+        {
+            return _ready.load(std::memory_order_acquire);
+        }
+
+        inline void future_slot::lock() noexcept
+        {
+            while (_lock.exchange(true, std::memory_order_acquire))
+            {
+                while (_lock.load(std::memory_order_relaxed))
+                {}
+            }
+        }
+
+        inline void future_slot::unlock() noexcept
+        {
+            _lock.store(false, std::memory_order_release);
+        }
+
+        inline future_base::future_base(detail::future_slot* slot) noexcept :
+            _slot(slot)
+        {}
+
+        inline future_base::future_base(future_base&& other) noexcept :
+            _slot(std::exchange(other._slot, nullptr))
+        {}
+
+        inline bool future_base::valid() const noexcept
+        {
+            return _slot != nullptr;
+        }
+
+        inline bool future_base::ready() const noexcept
+        {
+            assert(valid() && "Future has no result");
+            return _slot->ready();
+        }
+
+        inline void future_base::wait() noexcept
+        {
+            assert(valid() && "Future has no result");
+            _slot->counter.wait();
+        }
+
+        inline np::counter::wait_awaiter future_base::wait_async() noexcept
+        {
+            assert(valid() && "Future has no result");
+            return _slot->counter.wait_async();
+        }
+    }
+
+    template <typename T>
+    future<T>::future(::badge<fiber_pool_base>, detail::future_slot* slot) noexcept :
+        detail::future_base(slot)
+    {}
+
+    template <typename T>
+    future<T>& future<T>::operator=(future&& other) noexcept
+    {
+        reset();
+        _slot = std::exchange(other._slot, nullptr);
+        return *this;
+    }
+
+    template <typename T>
+    future<T>::~future() noexcept
+    {
+        reset();
+    }
+
+    template <typename T>
+    T future<T>::get() noexcept
+    {
+        wait();
+
+        detail::future_slot* slot = std::exchange(_slot, nullptr);
+        if constexpr (std::is_void_v<T>)
+        {
+            slot->release();
+        }
+        else
+        {
+            T* value = std::launder(reinterpret_cast<T*>(slot->storage()));
+            T result = std::move(*value);
+            value->~T();
+            slot->release();
+            return result;
+        }
+    }
+
+    template <typename T>
+    void future<T>::reset() noexcept
+    {
+        if (!_slot)
+        {
+            return;
+        }
+
+        wait();
+
+        if constexpr (!std::is_void_v<T>)
+        {
+            std::launder(reinterpret_cast<T*>(_slot->storage()))->~T();
+        }
+
+        std::exchange(_slot, nullptr)->release();
+    }
+
+    template <typename... T>
+    void when_all(future<T>&... futures) noexcept
+    {
+        (futures.wait(), ...);
+    }
+
+    template <typename R> requires std::ranges::range<R>
+    void when_all(R&& futures) noexcept
+    {
+        // Whichever is last to complete is waited for anyways, order doesn't matter
+        for (auto& future : futures)
+        {
+            future.wait();
+        }
+    }
+
+    template <typename... T>
+    std::size_t when_any(future<T>&... futures) noexcept
+    {
+        std::array<detail::future_base*, sizeof...(T)> all { &futures... };
+        return when_any(all);
+    }
+
+    template <typename R> requires std::ranges::range<R>
+    std::size_t when_any(R&& futures) noexcept
+    {
+        constexpr std::size_t none = std::numeric_limits<std::size_t>::max();
+
+        // Watching stops at the first one already complete, there is no need to wait then
+        detail::future_watch watch;
+        std::size_t watched = 0;
+        bool complete = false;
+        for (auto& future : futures)
+        {
+            if (!detail::future_access::slot(future)->watch(&watch))
+            {
+                complete = true;
+                break;
+            }
+
+            ++watched;
+        }
+
+        if (!complete)
+        {
+            assert(watched != 0 && "Nothing to wait for");
+            watch.wait();
+        }
+
+        // Once unwatched nobody touches the watch anymore, and it can go out of scope
+        std::size_t index = 0;
+        std::size_t first = none;
+        for (auto& future : futures)
+        {
+            detail::future_slot* slot = detail::future_access::slot(future);
+            if (index < watched)
+            {
+                slot->unwatch();
+            }
+
+            if (first == none && slot->ready())
+            {
+                first = index;
+            }
+
+            if (++index > watched && first != none)
+            {
+                break;
+            }
+        }
+
+        return first;
+    }
+}
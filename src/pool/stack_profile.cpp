@@ -0,0 +1,114 @@
+#include "pool/stack_profile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <string_view>
+
+
+namespace np
+{
+    namespace
+    {
+        constexpr uint64_t stack_canary = 0xC0DEFEEDC0DEFEEDull;
+
+        // Leaves only the callable type out of the signature of stack_site_of
+        std::string site_name(const char* signature)
+        {
+            std::string_view name(signature);
+
+            if (auto begin = name.find("F = "); begin != std::string_view::npos)
+            {
+                name.remove_prefix(begin + 4);
+                name = name.substr(0, std::min(name.rfind(']'), name.find(';')));
+            }
+            else if (auto open = name.find("stack_site_of<"); open != std::string_view::npos)
+            {
+                name.remove_prefix(open + 14);
+                name = name.substr(0, name.rfind('>'));
+            }
+
+            return std::string(name);
+        }
+    }
+
+    namespace detail
+    {
+        void paint_stack(const np::stack_context& stack) noexcept
+        {
+            uint64_t* top = static_cast<uint64_t*>(stack.top);
+            std::fill(top - stack.size / sizeof(uint64_t), top, stack_canary);
+        }
+
+        std::size_t stack_high_water_mark(const np::stack_context& stack) noexcept
+        {
+            // Stacks grow downwards, the first word that changed is as deep as the task went
+            uint64_t* top = static_cast<uint64_t*>(stack.top);
+            uint64_t* deepest = std::find_if(top - stack.size / sizeof(uint64_t), top, [](uint64_t word) { return word != stack_canary; });
+
+            std::fill(deepest, top, stack_canary);
+            return std::size_t(top - deepest) * sizeof(uint64_t);
+        }
+    }
+
+    std::size_t stack_histogram::percentile(double fraction) const noexcept
+    {
+        const uint64_t wanted = uint64_t(fraction * tasks + 0.5);
+
+        uint64_t seen = 0;
+        for (std::size_t bucket = 0; bucket < number_of_buckets; ++bucket)
+        {
+            seen += counts[bucket];
+            if (seen >= wanted && seen != 0)
+            {
+                return bucket_limit(bucket);
+            }
+        }
+
+        return 0;
+    }
+
+    stack_profile::stack_profile() noexcept :
+        _mutex(),
+        _pool(),
+        _sites()
+    {}
+
+    void stack_profile::record(const detail::stack_site* site, std::size_t used) noexcept
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        add(_pool, used);
+        add(_sites[site], used);
+    }
+
+    stack_profile_report stack_profile::report() const noexcept
+    {
+        stack_profile_report report;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        report.pool = _pool;
+        for (const auto& [site, histogram] : _sites)
+        {
+            report.sites.push_back({ site_name(site->signature), histogram });
+        }
+
+        std::sort(report.sites.begin(), report.sites.end(), [](const stack_site_usage& a, const stack_site_usage& b) {
+            return a.histogram.high_water_mark > b.histogram.high_water_mark;
+        });
+
+        return report;
+    }
+
+    std::size_t stack_profile::bucket_of(std::size_t used) noexcept
+    {
+        const std::size_t kilobytes = (used + 1023) / 1024;
+        const std::size_t bucket = kilobytes <= 1 ? 0 : std::bit_width(kilobytes - 1);
+        return std::min(bucket, stack_histogram::number_of_buckets - 1);
+    }
+
+    void stack_profile::add(stack_histogram& histogram, std::size_t used) noexcept
+    {
+        ++histogram.counts[bucket_of(used)];
+        ++histogram.tasks;
+        histogram.high_water_mark = std::max(histogram.high_water_mark, used);
+    }
+}
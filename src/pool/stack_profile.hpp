@@ -0,0 +1,93 @@
+#pragma once
+
+#include "core/stack_allocator.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace np
+{
+    namespace detail
+    {
+        // One per callable type pushed to a pool, tasks are grouped by it
+        struct stack_site
+        {
+            const char* signature;
+        };
+
+        template <typename F>
+        const stack_site* stack_site_of() noexcept
+        {
+#if defined(_MSC_VER)
+            static const stack_site site{ __FUNCSIG__ };
+#else
+            static const stack_site site{ __PRETTY_FUNCTION__ };
+#endif
+            return &site;
+        }
+
+        // Fills the usable part of a stack with the canary, committing all of its pages
+        void paint_stack(const np::stack_context& stack) noexcept;
+
+        // Bytes below the top that no longer hold the canary, which are painted again for the next task
+        std::size_t stack_high_water_mark(const np::stack_context& stack) noexcept;
+    }
+
+    // Bucket i counts tasks that used at most 1KB << i of stack
+    struct stack_histogram
+    {
+        static constexpr std::size_t number_of_buckets = 24;
+
+        std::array<uint64_t, number_of_buckets> counts;
+        uint64_t tasks;
+        std::size_t high_water_mark;
+
+        static constexpr std::size_t bucket_limit(std::size_t bucket) noexcept
+        {
+            return std::size_t(1024) << bucket;
+        }
+
+        // Smallest bucket limit that fits the given fraction of tasks, ie. 0.99 for the 99th percentile
+        std::size_t percentile(double fraction) const noexcept;
+    };
+
+    struct stack_site_usage
+    {
+        // Type of the callable, as the compiler spells it
+        std::string site;
+        stack_histogram histogram;
+    };
+
+    struct stack_profile_report
+    {
+        stack_histogram pool;
+
+        // Deepest first
+        std::vector<stack_site_usage> sites;
+    };
+
+    // Stack use of finished tasks in a pool, written by its dispatchers
+    class stack_profile
+    {
+    public:
+        stack_profile() noexcept;
+
+        void record(const detail::stack_site* site, std::size_t used) noexcept;
+        stack_profile_report report() const noexcept;
+
+    private:
+        static std::size_t bucket_of(std::size_t used) noexcept;
+        static void add(stack_histogram& histogram, std::size_t used) noexcept;
+
+    private:
+        mutable std::mutex _mutex;
+        stack_histogram _pool;
+        std::unordered_map<const detail::stack_site*, stack_histogram> _sites;
+    };
+}
@@ -0,0 +1,65 @@
+#include "pool/stats.hpp"
+
+#include <algorithm>
+#include <bit>
+
+
+namespace np
+{
+    uint64_t wait_histogram::samples() const noexcept
+    {
+        uint64_t total = 0;
+        for (uint64_t count : counts)
+        {
+            total += count;
+        }
+
+        return total;
+    }
+
+    std::chrono::microseconds wait_histogram::percentile(double fraction) const noexcept
+    {
+        const uint64_t wanted = uint64_t(fraction * samples() + 0.5);
+
+        uint64_t seen = 0;
+        for (std::size_t bucket = 0; bucket < number_of_buckets; ++bucket)
+        {
+            seen += counts[bucket];
+            if (seen >= wanted && seen != 0)
+            {
+                return bucket_limit(bucket);
+            }
+        }
+
+        return std::chrono::microseconds(0);
+    }
+
+    namespace detail
+    {
+        void worker_counters::wait(std::chrono::steady_clock::duration waited) noexcept
+        {
+            const auto microseconds = uint64_t(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(waited).count()));
+            const std::size_t bucket = std::min<std::size_t>(std::bit_width(microseconds), wait_histogram::number_of_buckets - 1);
+            bump(task_wait[bucket]);
+        }
+
+        void worker_counters::collect(worker_stats& stats) const noexcept
+        {
+            stats.dispatches += dispatches.load(std::memory_order_relaxed);
+            stats.tasks_started += tasks_started.load(std::memory_order_relaxed);
+            stats.unblocks += unblocks.load(std::memory_order_relaxed);
+            stats.yields += yields.load(std::memory_order_relaxed);
+            stats.blocks += blocks.load(std::memory_order_relaxed);
+            stats.tasks_ended += tasks_ended.load(std::memory_order_relaxed);
+            stats.coroutine_resumes += coroutine_resumes.load(std::memory_order_relaxed);
+            stats.steals += steals.load(std::memory_order_relaxed);
+            stats.idle_spins += idle_spins.load(std::memory_order_relaxed);
+            stats.parks += parks.load(std::memory_order_relaxed);
+
+            for (std::size_t bucket = 0; bucket < wait_histogram::number_of_buckets; ++bucket)
+            {
+                stats.task_wait.counts[bucket] += task_wait[bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
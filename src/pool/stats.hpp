@@ -0,0 +1,101 @@
+#pragma once
+
+#include "utils/cacheline.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace np
+{
+    // Time from push until a task first runs, bucket i counts waits of less than 1us << i
+    //  The last bucket takes everything longer
+    struct wait_histogram
+    {
+        static constexpr std::size_t number_of_buckets = 24;
+
+        std::array<uint64_t, number_of_buckets> counts;
+
+        static constexpr std::chrono::microseconds bucket_limit(std::size_t bucket) noexcept
+        {
+            return std::chrono::microseconds(int64_t(1) << bucket);
+        }
+
+        uint64_t samples() const noexcept;
+
+        // Smallest bucket limit that fits the given fraction of samples, ie. 0.99 for the 99th percentile
+        std::chrono::microseconds percentile(double fraction) const noexcept;
+    };
+
+    struct worker_stats
+    {
+        uint8_t worker_id;
+
+        // Fibers resumed, split by why they were runnable, and how they came back
+        uint64_t dispatches;
+        uint64_t tasks_started;
+        uint64_t unblocks;
+        uint64_t yields;
+        uint64_t blocks;
+        uint64_t tasks_ended;
+
+        // Coroutine tasks resumed, they don't count as dispatches
+        uint64_t coroutine_resumes;
+
+        // Fibers taken from other workers' deques
+        uint64_t steals;
+
+        // Dispatcher loops without anything to run, and times it went to sleep
+        uint64_t idle_spins;
+        uint64_t parks;
+
+        // Only a sample of the tasks is timed, see the wait_time_sampling trait
+        wait_histogram task_wait;
+    };
+
+    struct pool_stats
+    {
+        std::vector<worker_stats> workers;
+
+        // Sum of every worker, its id is meaningless
+        worker_stats total;
+
+        // Approximate depths, as queues are read while in use
+        std::size_t runnable_fibers;
+        std::size_t runnable_coroutines;
+        std::size_t pending_tasks;
+        std::size_t free_fibers;
+        std::size_t spawned_fibers;
+    };
+
+    namespace detail
+    {
+        // Only their worker writes them, so plain loads and stores do and snapshots may read them at any time
+        struct alignas(detail::cacheline_length) worker_counters
+        {
+            std::atomic<uint64_t> dispatches;
+            std::atomic<uint64_t> tasks_started;
+            std::atomic<uint64_t> unblocks;
+            std::atomic<uint64_t> yields;
+            std::atomic<uint64_t> blocks;
+            std::atomic<uint64_t> tasks_ended;
+            std::atomic<uint64_t> coroutine_resumes;
+            std::atomic<uint64_t> steals;
+            std::atomic<uint64_t> idle_spins;
+            std::atomic<uint64_t> parks;
+            std::array<std::atomic<uint64_t>, wait_histogram::number_of_buckets> task_wait;
+
+            void wait(std::chrono::steady_clock::duration waited) noexcept;
+            void collect(worker_stats& stats) const noexcept;
+        };
+
+        inline void bump(std::atomic<uint64_t>& counter) noexcept
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+}
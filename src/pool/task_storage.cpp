@@ -0,0 +1,104 @@
+#include "pool/task_storage.hpp"
+#include "core/fiber_base.hpp"
+
+#include <new>
+
+
+namespace np
+{
+    namespace detail
+    {
+        task_slabs::task_slabs(std::size_t block_size) noexcept :
+            _block_size((block_size + cacheline_length - 1) / cacheline_length * cacheline_length),
+            _blocks(),
+            _caches(),
+            _slabs_mutex(),
+            _slabs()
+        {}
+
+        task_slabs::~task_slabs() noexcept
+        {
+            for (worker_cache* cache : _caches)
+            {
+                delete cache;
+            }
+
+            for (void* slab : _slabs)
+            {
+                ::operator delete(slab, std::align_val_t(cacheline_length));
+            }
+        }
+
+        void* task_slabs::allocate(uint8_t worker) noexcept
+        {
+            worker_cache* cache = worker == unpinned ? nullptr : cache_of(worker);
+            if (cache && cache->size != 0)
+            {
+                return cache->blocks[--cache->size];
+            }
+
+            void* block;
+            if (_blocks.try_dequeue(block))
+            {
+                return block;
+            }
+
+            return allocate_slab(cache);
+        }
+
+        void task_slabs::deallocate(uint8_t worker, void* block) noexcept
+        {
+            worker_cache* cache = worker == unpinned ? nullptr : cache_of(worker);
+            if (!cache)
+            {
+                _blocks.enqueue(block);
+                return;
+            }
+
+            // Workers that only run tasks pushed by others would hoard them, give half back once full
+            if (cache->size == cached_blocks)
+            {
+                cache->size -= cached_blocks / 2;
+                _blocks.enqueue_bulk(cache->blocks.data() + cache->size, cached_blocks / 2);
+            }
+
+            cache->blocks[cache->size++] = block;
+        }
+
+        task_slabs::worker_cache* task_slabs::cache_of(uint8_t worker) noexcept
+        {
+            worker_cache*& cache = _caches[worker];
+            if (!cache)
+            {
+                cache = new worker_cache();
+            }
+
+            return cache;
+        }
+
+        void* task_slabs::allocate_slab(worker_cache* cache) noexcept
+        {
+            std::byte* slab = static_cast<std::byte*>(::operator new(slab_blocks * _block_size, std::align_val_t(cacheline_length)));
+            {
+                std::lock_guard<std::mutex> lock(_slabs_mutex);
+                _slabs.push_back(slab);
+            }
+
+            // The first block is returned, the rest go where the next allocation will look for them
+            for (std::size_t i = 1; i < slab_blocks; ++i)
+            {
+                void* block = slab + i * _block_size;
+                if (cache && cache->size != cached_blocks)
+                {
+                    cache->blocks[cache->size++] = block;
+                }
+                else
+                {
+                    _blocks.enqueue(block);
+                }
+            }
+
+            return slab;
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "utils/cacheline.hpp"
+
+#include <concurrentqueue.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+namespace np
+{
+    namespace detail
+    {
+        // Fixed size blocks for closures too big to be stored inline in tasks
+        //  Workers keep a few blocks of their own, so that pushing and running tasks on the same worker never
+        //  touches shared state, the rest go to a shared queue. Blocks are carved out of slabs, which are only
+        //  freed along with the storage
+        class task_slabs
+        {
+        public:
+            explicit task_slabs(std::size_t block_size) noexcept;
+            ~task_slabs() noexcept;
+
+            task_slabs(const task_slabs&) = delete;
+            task_slabs& operator=(const task_slabs&) = delete;
+
+            // Worker is the caller's own, or unpinned outside of the pool's workers
+            void* allocate(uint8_t worker) noexcept;
+            void deallocate(uint8_t worker, void* block) noexcept;
+
+            inline std::size_t block_size() const noexcept;
+
+        private:
+            static constexpr std::size_t slab_blocks = 64;
+            static constexpr std::size_t cached_blocks = 128;
+
+            struct alignas(cacheline_length) worker_cache
+            {
+                std::array<void*, cached_blocks> blocks;
+                std::size_t size;
+            };
+
+            // Only ever touched by its worker, created on first use
+            worker_cache* cache_of(uint8_t worker) noexcept;
+            void* allocate_slab(worker_cache* cache) noexcept;
+
+        private:
+            std::size_t _block_size;
+            moodycamel::ConcurrentQueue<void*> _blocks;
+            std::array<worker_cache*, 256> _caches;
+            std::mutex _slabs_mutex;
+            std::vector<void*> _slabs;
+        };
+
+
+        inline std::size_t task_slabs::block_size() const noexcept
+        {
+            return _block_size;
+        }
+    }
+}
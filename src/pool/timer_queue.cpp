@@ -0,0 +1,154 @@
+#include "pool/timer_queue.hpp"
+
+#include <cassert>
+
+
+namespace np
+{
+    namespace detail
+    {
+        timer_queue::timer_queue() noexcept :
+            _mutex(),
+            _heap(),
+            _next_deadline(no_deadline)
+        {}
+
+        bool timer_queue::add(timer* timer) noexcept
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            _heap.push_back(timer);
+            timer->heap_index = _heap.size() - 1;
+            sift_up(timer->heap_index);
+
+            update_next_deadline();
+            return _heap.front() == timer;
+        }
+
+        bool timer_queue::remove(timer* timer) noexcept
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            // Popped timers may have their slot reused, compare the pointer too
+            if (timer->heap_index >= _heap.size() || _heap[timer->heap_index] != timer)
+            {
+                return false;
+            }
+
+            erase(timer->heap_index);
+            update_next_deadline();
+            return true;
+        }
+
+        timer* timer_queue::pop_expired(clock::time_point now) noexcept
+        {
+            if (next_deadline() > now)
+            {
+                return nullptr;
+            }
+
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                return nullptr;
+            }
+
+            while (!_heap.empty() && _heap.front()->deadline <= now)
+            {
+                timer* expired = _heap.front();
+                erase(0);
+
+                wait_status expected = wait_status::waiting;
+                if (!expired->status || expired->status->compare_exchange_strong(expected, wait_status::timed_out, std::memory_order_acq_rel))
+                {
+                    update_next_deadline();
+                    return expired;
+                }
+            }
+
+            update_next_deadline();
+            return nullptr;
+        }
+
+        void timer_queue::sift_up(std::size_t index) noexcept
+        {
+            timer* moving = _heap[index];
+            while (index > 0)
+            {
+                std::size_t parent = (index - 1) / 2;
+                if (_heap[parent]->deadline <= moving->deadline)
+                {
+                    break;
+                }
+
+                place(index, _heap[parent]);
+                index = parent;
+            }
+
+            place(index, moving);
+        }
+
+        void timer_queue::sift_down(std::size_t index) noexcept
+        {
+            timer* moving = _heap[index];
+            const std::size_t size = _heap.size();
+            while (true)
+            {
+                std::size_t child = index * 2 + 1;
+                if (child >= size)
+                {
+                    break;
+                }
+
+                if (child + 1 < size && _heap[child + 1]->deadline < _heap[child]->deadline)
+                {
+                    ++child;
+                }
+
+                if (moving->deadline <= _heap[child]->deadline)
+                {
+                    break;
+                }
+
+                place(index, _heap[child]);
+                index = child;
+            }
+
+            place(index, moving);
+        }
+
+        void timer_queue::place(std::size_t index, timer* timer) noexcept
+        {
+            _heap[index] = timer;
+            timer->heap_index = index;
+        }
+
+        void timer_queue::erase(std::size_t index) noexcept
+        {
+            assert(index < _heap.size() && "Timer is not in the queue");
+
+            timer* last = _heap.back();
+            _heap.pop_back();
+            if (index == _heap.size())
+            {
+                return;
+            }
+
+            // The last timer may belong either above or below the hole
+            place(index, last);
+            if (index > 0 && last->deadline < _heap[(index - 1) / 2]->deadline)
+            {
+                sift_up(index);
+            }
+            else
+            {
+                sift_down(index);
+            }
+        }
+
+        void timer_queue::update_next_deadline() noexcept
+        {
+            _next_deadline.store(_heap.empty() ? no_deadline : _heap.front()->deadline.time_since_epoch().count(), std::memory_order_release);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+
+namespace np
+{
+    class fiber_base;
+
+    namespace detail
+    {
+        // Timed waits race a notifier against the timer, whoever moves it out of waiting wakes the fiber
+        enum class wait_status : uint8_t
+        {
+            waiting,
+            notified,
+            timed_out
+        };
+
+        // Owned by whoever waits on it, usually on the stack of the sleeping fiber
+        struct timer
+        {
+            std::chrono::steady_clock::time_point deadline;
+            np::fiber_base* fiber;
+            std::size_t heap_index;
+
+            // Plain sleeps leave it null and always fire
+            std::atomic<wait_status>* status;
+        };
+
+        // Min-heap of timers shared by all workers of a pool
+        //  The earliest deadline is mirrored in an atomic, so dispatchers can check it without locking
+        class timer_queue
+        {
+        public:
+            using clock = std::chrono::steady_clock;
+
+            timer_queue() noexcept;
+
+            // True if the timer is now the earliest one
+            bool add(timer* timer) noexcept;
+
+            // False if the timer had already been popped
+            bool remove(timer* timer) noexcept;
+
+            // Pops one timer due at now, if any and if no other thread is popping already
+            //  Timers whose status was already claimed are dropped, the claim happens under the lock, so
+            //  that once remove returns nobody else touches the timer
+            timer* pop_expired(clock::time_point now) noexcept;
+
+            inline bool empty() const noexcept;
+            inline clock::time_point next_deadline() const noexcept;
+
+        private:
+            void sift_up(std::size_t index) noexcept;
+            void sift_down(std::size_t index) noexcept;
+            void place(std::size_t index, timer* timer) noexcept;
+            void erase(std::size_t index) noexcept;
+            void update_next_deadline() noexcept;
+
+        private:
+            static constexpr clock::rep no_deadline = std::numeric_limits<clock::rep>::max();
+
+            std::mutex _mutex;
+            std::vector<timer*> _heap;
+            std::atomic<clock::rep> _next_deadline;
+        };
+
+
+        inline bool timer_queue::empty() const noexcept
+        {
+            return _next_deadline.load(std::memory_order_relaxed) == no_deadline;
+        }
+
+        inline timer_queue::clock::time_point timer_queue::next_deadline() const noexcept
+        {
+            return clock::time_point(clock::duration(_next_deadline.load(std::memory_order_acquire)));
+        }
+    }
+}
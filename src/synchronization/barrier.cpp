@@ -22,7 +22,8 @@ namespace np
 	{
 		if (--_waiting == 0)
 		{
-			while (_waiting_fibers.size_approx() != _size)
+			// Everyone else decreased before queueing, wait until all of them are in
+			while (_waiting_fibers.size_approx() != _size - 1)
 			{
 				this_fiber::yield();
 			}
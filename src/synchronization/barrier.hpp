@@ -4,6 +4,8 @@
 
 #include <atomic>
 
+#include <concurrentqueue.h>
+
 
 namespace np
 {
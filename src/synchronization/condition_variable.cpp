@@ -1,27 +1,22 @@
 #include "synchronization/condition_variable.hpp"
 #include "pool/fiber_pool.hpp"
+#include "synchronization/mutex.hpp"
 
 
 namespace np
 {
 	void condition_variable::notify_one() noexcept
 	{
-		np::fiber_base* fiber;
-		if (_waiting_fibers.try_dequeue(fiber))
-		{
-			assert(fiber->get_fiber_pool() != nullptr && "Conditions variable require a fiber pool");
-			fiber->get_fiber_pool()->unblock({}, fiber);
-		}
+		_waiters.lock();
+		_waiters.notify_one();
+		_waiters.unlock();
 	}
 
 	void condition_variable::notify_all() noexcept
 	{
-		np::fiber_base* fiber;
-		while (_waiting_fibers.try_dequeue(fiber))
-		{
-			assert(fiber->get_fiber_pool() != nullptr && "Conditions variable require a fiber pool");
-			fiber->get_fiber_pool()->unblock({}, fiber);
-		}
+		_waiters.lock();
+		_waiters.notify_all();
+		_waiters.unlock();
 	}
 
 	void condition_variable::wait(np::mutex& mutex) noexcept
@@ -29,9 +24,57 @@ namespace np
 		auto fiber = this_fiber::instance();
 		assert(fiber->get_fiber_pool() != nullptr && "Conditions variable require a fiber pool");
 
-		_waiting_fibers.enqueue(fiber);
+		detail::waiter waiter(fiber);
+		_waiters.lock();
+		_waiters.push(waiter);
+		_waiters.unlock();
+
 		mutex.unlock();
-		fiber->get_fiber_pool()->block({});
+		_waiters.block(waiter);
 		mutex.lock();
 	}
+
+	std::cv_status condition_variable::wait_until(np::mutex& mutex, std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		auto fiber = this_fiber::instance();
+		assert(fiber->get_fiber_pool() != nullptr && "Conditions variable require a fiber pool");
+
+		detail::waiter waiter(fiber);
+		_waiters.lock();
+		_waiters.push(waiter, deadline);
+		_waiters.unlock();
+
+		mutex.unlock();
+		bool notified = _waiters.block(waiter);
+		mutex.lock();
+
+		return notified ? std::cv_status::no_timeout : std::cv_status::timeout;
+	}
+
+	np::task<> condition_variable::wait_async(np::mutex& mutex) noexcept
+	{
+		co_await wait_awaiter{ *this, mutex };
+		co_await mutex.lock_async();
+	}
+
+	condition_variable::wait_awaiter::wait_awaiter(condition_variable& condition_variable, np::mutex& mutex) noexcept :
+		_condition_variable(condition_variable),
+		_mutex(mutex),
+		_waiter(std::coroutine_handle<>{}, nullptr)
+	{}
+
+	void condition_variable::wait_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+	{
+		_waiter.coroutine = coroutine;
+		_waiter.fiber_pool = fiber_pool_base::running_pool();
+		assert(_waiter.fiber_pool && "Tasks can only wait while run by a fiber pool");
+
+		// Queued before unlocking, as fibers do, but we may be resumed elsewhere right after, don't touch this
+		np::mutex& mutex = _mutex;
+		_condition_variable._waiters.lock();
+		_condition_variable._waiters.push(_waiter);
+		_condition_variable._waiters.unlock();
+
+		mutex.unlock();
+	}
 }
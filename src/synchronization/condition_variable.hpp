@@ -1,6 +1,11 @@
 #pragma once
 
-#include <concurrentqueue.h>
+#include "coroutine/task.hpp"
+#include "synchronization/detail/wait_queue.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
 
 
 namespace np
@@ -11,6 +16,23 @@ namespace np
 
 	class condition_variable
 	{
+	public:
+		// Suspends a task until notified, releasing the mutex once parked but leaving it unlocked on resume
+		class wait_awaiter
+		{
+		public:
+			wait_awaiter(condition_variable& condition_variable, np::mutex& mutex) noexcept;
+
+			bool await_ready() noexcept { return false; }
+			void await_suspend(std::coroutine_handle<> coroutine) noexcept;
+			void await_resume() noexcept {}
+
+		private:
+			condition_variable& _condition_variable;
+			np::mutex& _mutex;
+			detail::waiter _waiter;
+		};
+
 	public:
 		condition_variable() noexcept = default;
 
@@ -18,7 +40,51 @@ namespace np
 		void notify_all() noexcept;
 		void wait(np::mutex& mutex) noexcept;
 
+		// The mutex is locked again on return, whether notified or not
+		std::cv_status wait_until(np::mutex& mutex, std::chrono::steady_clock::time_point deadline) noexcept;
+
+		template <typename rep, typename period>
+		std::cv_status wait_for(np::mutex& mutex, const std::chrono::duration<rep, period>& duration) noexcept;
+
+		// Returns the last evaluation of the predicate
+		template <typename P>
+		bool wait_until(np::mutex& mutex, std::chrono::steady_clock::time_point deadline, P&& predicate) noexcept;
+
+		template <typename rep, typename period, typename P>
+		bool wait_for(np::mutex& mutex, const std::chrono::duration<rep, period>& duration, P&& predicate) noexcept;
+
+		// Only from tasks, as in co_await cv.wait_async(mutex), the mutex is locked again through lock_async
+		//	Coroutines can't be timed, there is no async counterpart of wait_until
+		np::task<> wait_async(np::mutex& mutex) noexcept;
+
 	private:
-		moodycamel::ConcurrentQueue<np::fiber_base*> _waiting_fibers;
+		detail::wait_queue _waiters;
 	};
+
+
+	template <typename rep, typename period>
+	std::cv_status condition_variable::wait_for(np::mutex& mutex, const std::chrono::duration<rep, period>& duration) noexcept
+	{
+		return wait_until(mutex, std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+	}
+
+	template <typename P>
+	bool condition_variable::wait_until(np::mutex& mutex, std::chrono::steady_clock::time_point deadline, P&& predicate) noexcept
+	{
+		while (!predicate())
+		{
+			if (wait_until(mutex, deadline) == std::cv_status::timeout)
+			{
+				return predicate();
+			}
+		}
+
+		return true;
+	}
+
+	template <typename rep, typename period, typename P>
+	bool condition_variable::wait_for(np::mutex& mutex, const std::chrono::duration<rep, period>& duration, P&& predicate) noexcept
+	{
+		return wait_until(mutex, std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration), std::forward<P>(predicate));
+	}
 }
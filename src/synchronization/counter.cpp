@@ -1,18 +1,39 @@
 #include "synchronization/counter.hpp"
 #include "pool/fiber_pool.hpp"
 
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 
 namespace np
 {
+	namespace
+	{
+		// Threads outside of pools park here, counters share buckets by address
+		struct thread_parking
+		{
+			std::mutex mutex;
+			std::condition_variable condition;
+		};
+
+		std::array<thread_parking, 16> thread_parkings;
+
+		thread_parking& parking_of(const void* address) noexcept
+		{
+			return thread_parkings[(reinterpret_cast<std::uintptr_t>(address) >> 6) % thread_parkings.size()];
+		}
+	}
+
 	counter::counter() noexcept :
 		counter { false }
 	{}
 
 	counter::counter(bool ignore_waiter) noexcept :
 		_ignore_waiter(ignore_waiter),
-		_size(0),
-		_done(0),
-		_fiber(nullptr)
+		_state(0),
+		_waiters()
 #if !defined(NDEBUG)
 		,_on_wait_end([] {})
 #endif
@@ -20,25 +41,22 @@ namespace np
 
 	counter::counter(counter&& other) noexcept :
 		_ignore_waiter(other._ignore_waiter),
-		_size((std::size_t)other._size),
-		_done((std::size_t)other._done),
-		_fiber((fiber_base*)other._fiber)
+		_state(0),
+		_waiters()
 #if !defined(NDEBUG)
 		, _on_wait_end(std::move(other._on_wait_end))
 #endif
 	{
-		assert(other._size == other._done && "Can't move a counter that is still being actively used");
+		assert(other._state == 0 && "Can't move a counter that is still being actively used");
 	}
 
 	counter& counter::operator=(counter&& other) noexcept
 	{
-		assert(other._size == other._done && "Can't move a counter that is still being actively used");
-		
+		assert(other._state == 0 && "Can't move a counter that is still being actively used");
+
 		_ignore_waiter = other._ignore_waiter;
-		_size = (std::size_t)other._size;
-		_done = (std::size_t)other._done;
-		_fiber = (fiber_base*)other._fiber;
-		
+		_state = 0;
+
 #if !defined(NDEBUG)
 		_on_wait_end = std::move(other._on_wait_end);
 #endif
@@ -48,45 +66,219 @@ namespace np
 
 	void counter::reset() noexcept
 	{
-		_size = 0;
-        _done = 0;
-		_fiber = nullptr;
+		assert(_waiters.empty() && "Can't reset a counter with waiting fibers");
+
+		_state = 0;
 	}
 
 	void counter::done_impl(fiber_pool_base* fiber_pool) noexcept
 	{
+        // Nobody waits on them, and they were never increased
         if (_ignore_waiter)
         {
-            ++_done;
             return;
         }
 
-        np::fiber_base* waiter;
-        while (!(waiter = _fiber.load(std::memory_order_relaxed)))
-        {
-			fiber_pool->yield();
-		}
+		uint64_t previous = _state.fetch_sub(1, std::memory_order_acq_rel);
+		assert((previous & pending_mask) != 0 && "Counter done more times than increased");
 
-		if (++_done == _size)
+		if (previous == (waiters_flag | 1))
 		{
-			fiber_pool->unblock({}, waiter);
+			wake_waiters();
 		}
 	}
 
 	void counter::wait() noexcept
 	{
-		assert(_fiber.load(std::memory_order_relaxed) == nullptr && "Only one fiber can wait on a counter");
+		wait_impl(nullptr);
+	}
 
-		if (_size)
+	bool counter::wait_until(std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		return wait_impl(&deadline);
+	}
+
+	bool counter::wait_impl(const std::chrono::steady_clock::time_point* deadline) noexcept
+	{
+		// A leftover flag or a held lock means the last completer may still be waking others, the slow
+		//	path doesn't return under its feet
+		if (_state.load(std::memory_order_acquire) != 0 || _waiters.locked())
 		{
-			auto fiber = this_fiber::instance();
-			_fiber.store(fiber, std::memory_order_release);
-			fiber->get_fiber_pool()->block({});
+			auto fiber = fiber_pool_base::running_fiber();
+			if (!(fiber ? wait_fiber(fiber, deadline) : wait_thread(deadline)))
+			{
+				return false;
+			}
 		}
 
 #if !defined(NDEBUG)
 		_on_wait_end();
 		_on_wait_end = [] {};
 #endif
+
+		return true;
+	}
+
+	bool counter::announce_waiter() noexcept
+	{
+		// Done once nothing is pending, otherwise whoever completes the last task will wake us
+		uint64_t state = _state.load(std::memory_order_acquire);
+		while ((state & pending_mask) != 0)
+		{
+			if ((state & waiters_flag) || _state.compare_exchange_weak(state, state | waiters_flag, std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void counter::settle() noexcept
+	{
+		// The count reaches zero before the completer gets the lock, it holds it from clearing the flag until
+		//	it is done with the counter
+		while (_state.load(std::memory_order_acquire) & waiters_flag)
+		{
+			_waiters.unlock();
+			std::this_thread::yield();
+			_waiters.lock();
+		}
+
+		_waiters.unlock();
+	}
+
+	bool counter::wait_fiber(np::fiber_base* fiber, const std::chrono::steady_clock::time_point* deadline) noexcept
+	{
+		// Counters may be increased again before we get to run, in which case we wait once more
+		for (;;)
+		{
+			detail::waiter waiter(fiber);
+
+			_waiters.lock();
+			if (!announce_waiter())
+			{
+				settle();
+				return true;
+			}
+
+			// Even expired deadlines go through the timers, so that polling with them lets others run
+			if (deadline)
+			{
+				_waiters.push(waiter, *deadline);
+			}
+			else
+			{
+				_waiters.push(waiter);
+			}
+
+			_waiters.unlock();
+
+			if (!_waiters.block(waiter))
+			{
+				return false;
+			}
+		}
+	}
+
+	bool counter::wait_thread(const std::chrono::steady_clock::time_point* deadline) noexcept
+	{
+		auto& parking = parking_of(this);
+
+		for (;;)
+		{
+			_waiters.lock();
+			if (!announce_waiter())
+			{
+				settle();
+				return true;
+			}
+
+			_waiters.unlock();
+
+			// The flag is cleared before notifying under the parking lock, so checking it under that same lock can't miss it
+			std::unique_lock<std::mutex> lock(parking.mutex);
+			while (_state.load(std::memory_order_acquire) & waiters_flag)
+			{
+				if (!deadline)
+				{
+					parking.condition.wait(lock);
+				}
+				else if (parking.condition.wait_until(lock, *deadline) == std::cv_status::timeout)
+				{
+					if (_state.load(std::memory_order_acquire) & pending_mask)
+					{
+						return false;
+					}
+
+					// Done just in time, but the completer may not be done with us yet
+					lock.unlock();
+					_waiters.lock();
+					settle();
+					return true;
+				}
+			}
+		}
+	}
+
+	counter::wait_awaiter::wait_awaiter(counter& counter) noexcept :
+		_counter(counter),
+		_waiter(std::coroutine_handle<>{}, nullptr),
+		_parked(false)
+	{}
+
+	bool counter::wait_awaiter::await_ready() noexcept
+	{
+		return _counter._state.load(std::memory_order_acquire) == 0 && !_counter._waiters.locked();
+	}
+
+	bool counter::wait_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+	{
+		_waiter.coroutine = coroutine;
+		_waiter.fiber_pool = fiber_pool_base::running_pool();
+		assert(_waiter.fiber_pool && "Tasks can only wait while run by a fiber pool");
+
+		// Same as fibers, but once pushed we may be resumed elsewhere before returning, don't touch this after unlocking
+		_counter._waiters.lock();
+		if (!_counter.announce_waiter())
+		{
+			_counter.settle();
+			return false;
+		}
+
+		_parked = true;
+		_counter._waiters.push(_waiter);
+		_counter._waiters.unlock();
+		return true;
+	}
+
+	void counter::wait_awaiter::await_resume() noexcept
+	{
+		// Resumed while the completer still holds the lock, wait for it to let go
+		if (_parked)
+		{
+			_counter._waiters.lock();
+			_counter._waiters.unlock();
+		}
+
+#if !defined(NDEBUG)
+		_counter._on_wait_end();
+		_counter._on_wait_end = [] {};
+#endif
+	}
+
+	void counter::wake_waiters() noexcept
+	{
+		// Waiters announce themselves under the lock, so nobody can set the flag again before they are woken
+		_waiters.lock();
+		_state.fetch_and(~waiters_flag, std::memory_order_acq_rel);
+		_waiters.notify_all();
+		_waiters.unlock();
+
+		auto& parking = parking_of(this);
+		{
+			std::lock_guard<std::mutex> lock(parking.mutex);
+		}
+		parking.condition.notify_all();
 	}
 }
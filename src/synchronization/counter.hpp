@@ -1,8 +1,12 @@
 #pragma once
 
+#include "synchronization/detail/wait_queue.hpp"
 #include "utils/badge.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
 #include <inplace_function.h>
 
 
@@ -11,8 +15,39 @@ namespace np
 	class fiber_base;
     class fiber_pool_base;
 
+	namespace detail
+	{
+		class future_slot;
+		class future_watch;
+		class task_promise_base;
+	}
+
+	// Counts tasks pushed along it and not done yet, waiting is possible from fibers and plain threads alike
+	//	Both the count and whether anyone waits live in the same atomic, so completions take a single
+	//	RMW and only the one reaching zero with waiters around touches the wait queue
 	class counter
 	{
+		friend class detail::future_slot;
+		friend class detail::future_watch;
+		friend class detail::task_promise_base;
+
+	public:
+		// Suspends a task instead of blocking its worker, it is resumed once the counter reaches zero
+		class wait_awaiter
+		{
+		public:
+			explicit wait_awaiter(counter& counter) noexcept;
+
+			bool await_ready() noexcept;
+			bool await_suspend(std::coroutine_handle<> coroutine) noexcept;
+			void await_resume() noexcept;
+
+		private:
+			counter& _counter;
+			detail::waiter _waiter;
+			bool _parked;
+		};
+
 	public:
 		counter() noexcept;
 		counter(bool ignore_waiter) noexcept;
@@ -23,7 +58,17 @@ namespace np
 		void reset() noexcept;
 		void wait() noexcept;
 
+		// False if the deadline passed before every task was done
+		bool wait_until(std::chrono::steady_clock::time_point deadline) noexcept;
+
+		template <typename rep, typename period>
+		bool wait_for(const std::chrono::duration<rep, period>& duration) noexcept;
+
+		// Only from tasks, as in co_await counter.wait_async()
+		inline wait_awaiter wait_async() noexcept;
+
         inline void increase(badge<fiber_pool_base>) noexcept;
+        inline void increase(badge<fiber_pool_base>, std::size_t amount) noexcept;
 		inline void done(badge<fiber_base>, fiber_pool_base* fiber_pool) noexcept;
 
 #if !defined(NDEBUG)
@@ -33,12 +78,25 @@ namespace np
 
     protected:
         void done_impl(fiber_pool_base* fiber_pool) noexcept;
+		bool wait_impl(const std::chrono::steady_clock::time_point* deadline) noexcept;
+
+	private:
+		static constexpr uint64_t waiters_flag = uint64_t(1) << 63;
+		static constexpr uint64_t pending_mask = waiters_flag - 1;
+
+		bool announce_waiter() noexcept;
+
+		// Called with the lock held once nothing is pending, releases it only after the last completer
+		//	is done clearing the flag and waking waiters, the counter may be destroyed right after
+		void settle() noexcept;
+		bool wait_fiber(np::fiber_base* fiber, const std::chrono::steady_clock::time_point* deadline) noexcept;
+		bool wait_thread(const std::chrono::steady_clock::time_point* deadline) noexcept;
+		void wake_waiters() noexcept;
 
 	private:
 		bool _ignore_waiter;
-		std::atomic<std::size_t> _size;
-		std::atomic<std::size_t> _done;
-		std::atomic<fiber_base*> _fiber;
+		std::atomic<uint64_t> _state;
+		detail::wait_queue _waiters;
 
 #if !defined(NDEBUG)
 		stdext::inplace_function<void()> _on_wait_end;
@@ -48,7 +106,12 @@ namespace np
 
     inline void counter::increase(badge<fiber_pool_base>) noexcept
     {
-        ++_size;
+        _state.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void counter::increase(badge<fiber_pool_base>, std::size_t amount) noexcept
+    {
+        _state.fetch_add(uint64_t(amount), std::memory_order_relaxed);
     }
 
     inline void counter::done(badge<fiber_base>, fiber_pool_base* fiber_pool) noexcept
@@ -56,6 +119,17 @@ namespace np
 		done_impl(fiber_pool);
     }
 
+	inline counter::wait_awaiter counter::wait_async() noexcept
+	{
+		return wait_awaiter{ *this };
+	}
+
+	template <typename rep, typename period>
+	bool counter::wait_for(const std::chrono::duration<rep, period>& duration) noexcept
+	{
+		return wait_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+	}
+
 #if !defined(NDEBUG)
 	template <typename C>
 	inline void counter::on_wait_done(C&& callback) noexcept
@@ -0,0 +1,189 @@
+#include "synchronization/counting_semaphore.hpp"
+#include "pool/fiber_pool.hpp"
+
+
+namespace np
+{
+	counting_semaphore::permits_waiter::permits_waiter(np::fiber_base* fiber, uint64_t permits) noexcept :
+		detail::waiter(fiber),
+		permits(permits)
+	{}
+
+	counting_semaphore::permits_waiter::permits_waiter(std::coroutine_handle<> coroutine, np::fiber_pool_base* fiber_pool, uint64_t permits) noexcept :
+		detail::waiter(coroutine, fiber_pool),
+		permits(permits)
+	{}
+
+	counting_semaphore::counting_semaphore(std::ptrdiff_t desired) noexcept :
+		_state(uint64_t(desired)),
+		_waiters()
+	{
+		assert(desired >= 0 && desired <= max() && "Semaphore permits out of range");
+	}
+
+	void counting_semaphore::acquire(std::ptrdiff_t count) noexcept
+	{
+		if (!try_acquire(count))
+		{
+			acquire_slow(uint64_t(count), nullptr);
+		}
+	}
+
+	bool counting_semaphore::try_acquire(std::ptrdiff_t count) noexcept
+	{
+		assert(count >= 0 && count <= max() && "Semaphore permits out of range");
+
+		// Queued fibers go first
+		uint64_t state = _state.load(std::memory_order_relaxed);
+		while (state < one_waiter && state >= uint64_t(count))
+		{
+			if (_state.compare_exchange_weak(state, state - uint64_t(count), std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool counting_semaphore::try_acquire_until(std::chrono::steady_clock::time_point deadline, std::ptrdiff_t count) noexcept
+	{
+		return try_acquire(count) || acquire_slow(uint64_t(count), &deadline);
+	}
+
+	void counting_semaphore::release(std::ptrdiff_t count) noexcept
+	{
+		assert(count >= 0 && "Can't release a negative number of permits");
+
+		uint64_t previous = _state.fetch_add(uint64_t(count), std::memory_order_acq_rel);
+		assert((previous & permits_mask) + uint64_t(count) <= uint64_t(max()) && "Semaphore permits overflow");
+
+		if (previous >= one_waiter)
+		{
+			grant();
+		}
+	}
+
+	bool counting_semaphore::take(uint64_t permits) noexcept
+	{
+		uint64_t state = _state.load(std::memory_order_relaxed);
+		while ((state & permits_mask) >= permits)
+		{
+			if (_state.compare_exchange_weak(state, state - permits, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool counting_semaphore::acquire_slow(uint64_t permits, const std::chrono::steady_clock::time_point* deadline) noexcept
+	{
+		auto fiber = this_fiber::instance();
+		assert(fiber && fiber->get_fiber_pool() != nullptr && "Fiber that block in semaphores must come from fiber pools");
+
+		permits_waiter waiter(fiber, permits);
+
+		// Both sides modify the same word, so either release sees us or we see its permits
+		_waiters.lock();
+		_state.fetch_add(one_waiter, std::memory_order_acq_rel);
+		if (_waiters.empty() && take(permits))
+		{
+			_state.fetch_sub(one_waiter, std::memory_order_relaxed);
+			_waiters.unlock();
+			return true;
+		}
+
+		if (!deadline)
+		{
+			_waiters.push(waiter);
+		}
+		else if (std::chrono::steady_clock::now() < *deadline)
+		{
+			_waiters.push(waiter, *deadline);
+		}
+		else
+		{
+			_state.fetch_sub(one_waiter, std::memory_order_relaxed);
+			_waiters.unlock();
+			return false;
+		}
+
+		_waiters.unlock();
+
+		// Permits are taken on our behalf before waking us
+		bool granted = _waiters.block(waiter);
+		_state.fetch_sub(one_waiter, std::memory_order_relaxed);
+
+		// We might have been holding back those queued behind us
+		if (!granted)
+		{
+			grant();
+		}
+
+		return granted;
+	}
+
+	counting_semaphore::acquire_awaiter::acquire_awaiter(counting_semaphore& semaphore, std::ptrdiff_t count) noexcept :
+		_semaphore(semaphore),
+		_waiter(std::coroutine_handle<>{}, nullptr, uint64_t(count)),
+		_parked(false)
+	{}
+
+	bool counting_semaphore::acquire_awaiter::await_ready() noexcept
+	{
+		return _semaphore.try_acquire(std::ptrdiff_t(_waiter.permits));
+	}
+
+	bool counting_semaphore::acquire_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+	{
+		_waiter.coroutine = coroutine;
+		_waiter.fiber_pool = fiber_pool_base::running_pool();
+		assert(_waiter.fiber_pool && "Tasks can only acquire semaphores while run by a fiber pool");
+
+		// As in acquire_slow, but once pushed we may be resumed elsewhere before returning, don't touch this after unlocking
+		_semaphore._waiters.lock();
+		_semaphore._state.fetch_add(one_waiter, std::memory_order_acq_rel);
+		if (_semaphore._waiters.empty() && _semaphore.take(_waiter.permits))
+		{
+			_semaphore._state.fetch_sub(one_waiter, std::memory_order_relaxed);
+			_semaphore._waiters.unlock();
+			return false;
+		}
+
+		_parked = true;
+		_semaphore._waiters.push(_waiter);
+		_semaphore._waiters.unlock();
+		return true;
+	}
+
+	void counting_semaphore::acquire_awaiter::await_resume() noexcept
+	{
+		// Permits were taken on our behalf before resuming us, we are no longer queued
+		if (_parked)
+		{
+			_semaphore._state.fetch_sub(one_waiter, std::memory_order_relaxed);
+		}
+	}
+
+	void counting_semaphore::grant() noexcept
+	{
+		_waiters.lock();
+		while (detail::waiter* front = _waiters.front())
+		{
+			auto& waiter = static_cast<permits_waiter&>(*front);
+			if (!take(waiter.permits))
+			{
+				break;
+			}
+
+			// It timed out meanwhile, the permits are still free for whoever comes next
+			if (!_waiters.notify(waiter))
+			{
+				_state.fetch_add(waiter.permits, std::memory_order_relaxed);
+			}
+		}
+		_waiters.unlock();
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "synchronization/detail/wait_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace np
+{
+	class fiber_base;
+	class fiber_pool_base;
+
+	// Permits and queued fibers share a single atomic, so acquiring without waiters and releasing
+	//	without waiters are both lock-free. Waiters are served in order, a fiber asking for many permits
+	//	can't be starved by others asking for few, nor by newcomers, which queue behind it
+	class counting_semaphore
+	{
+	public:
+		// Suspends a task instead of blocking its worker, it holds the permits once resumed
+		class acquire_awaiter;
+
+	public:
+		explicit counting_semaphore(std::ptrdiff_t desired) noexcept;
+
+		counting_semaphore(const counting_semaphore&) = delete;
+		counting_semaphore& operator=(const counting_semaphore&) = delete;
+
+		static constexpr std::ptrdiff_t max() noexcept;
+
+		void acquire(std::ptrdiff_t count = 1) noexcept;
+		bool try_acquire(std::ptrdiff_t count = 1) noexcept;
+		bool try_acquire_until(std::chrono::steady_clock::time_point deadline, std::ptrdiff_t count = 1) noexcept;
+
+		template <typename rep, typename period>
+		bool try_acquire_for(const std::chrono::duration<rep, period>& duration, std::ptrdiff_t count = 1) noexcept;
+
+		void release(std::ptrdiff_t count = 1) noexcept;
+
+		// Only from tasks, as in co_await semaphore.acquire_async(), releasing is the same for everyone
+		inline acquire_awaiter acquire_async(std::ptrdiff_t count = 1) noexcept;
+
+	private:
+		// Permits in the low half, queued fibers in the high half
+		static constexpr uint64_t permits_mask = 0xFFFFFFFF;
+		static constexpr uint64_t one_waiter = uint64_t(1) << 32;
+
+		struct permits_waiter : detail::waiter
+		{
+			permits_waiter(np::fiber_base* fiber, uint64_t permits) noexcept;
+			permits_waiter(std::coroutine_handle<> coroutine, np::fiber_pool_base* fiber_pool, uint64_t permits) noexcept;
+
+			uint64_t permits;
+		};
+
+		bool take(uint64_t permits) noexcept;
+		bool acquire_slow(uint64_t permits, const std::chrono::steady_clock::time_point* deadline) noexcept;
+		void grant() noexcept;
+
+	private:
+		std::atomic<uint64_t> _state;
+		detail::wait_queue _waiters;
+	};
+
+	class counting_semaphore::acquire_awaiter
+	{
+	public:
+		acquire_awaiter(counting_semaphore& semaphore, std::ptrdiff_t count) noexcept;
+
+		bool await_ready() noexcept;
+		bool await_suspend(std::coroutine_handle<> coroutine) noexcept;
+		void await_resume() noexcept;
+
+	private:
+		counting_semaphore& _semaphore;
+		permits_waiter _waiter;
+		bool _parked;
+	};
+
+
+	constexpr std::ptrdiff_t counting_semaphore::max() noexcept
+	{
+		return std::ptrdiff_t(permits_mask >> 1);
+	}
+
+	inline counting_semaphore::acquire_awaiter counting_semaphore::acquire_async(std::ptrdiff_t count) noexcept
+	{
+		return acquire_awaiter{ *this, count };
+	}
+
+	template <typename rep, typename period>
+	bool counting_semaphore::try_acquire_for(const std::chrono::duration<rep, period>& duration, std::ptrdiff_t count) noexcept
+	{
+		return try_acquire_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration), count);
+	}
+}
@@ -0,0 +1,177 @@
+#include "synchronization/detail/wait_queue.hpp"
+#include "pool/fiber_pool.hpp"
+
+
+namespace np
+{
+	namespace detail
+	{
+		waiter::waiter(np::fiber_base* fiber) noexcept :
+			fiber(fiber),
+			coroutine(),
+			fiber_pool(nullptr),
+			status(wait_status::waiting),
+			timer{ {}, fiber, 0, &status },
+			timed(false),
+			queued(false),
+			previous(nullptr),
+			next(nullptr)
+		{}
+
+		waiter::waiter(std::coroutine_handle<> coroutine, np::fiber_pool_base* fiber_pool) noexcept :
+			fiber(nullptr),
+			coroutine(coroutine),
+			fiber_pool(fiber_pool),
+			status(wait_status::waiting),
+			timer{ {}, nullptr, 0, &status },
+			timed(false),
+			queued(false),
+			previous(nullptr),
+			next(nullptr)
+		{}
+
+		wait_queue::wait_queue() noexcept :
+			_lock(false),
+			_head(nullptr),
+			_tail(nullptr)
+		{}
+
+		void wait_queue::push(waiter& waiter) noexcept
+		{
+			assert(!waiter.queued && "Waiter is already queued");
+
+			waiter.queued = true;
+			waiter.previous = _tail;
+			waiter.next = nullptr;
+
+			if (_tail)
+			{
+				_tail->next = &waiter;
+			}
+			else
+			{
+				_head = &waiter;
+			}
+
+			_tail = &waiter;
+		}
+
+		void wait_queue::push(waiter& waiter, clock::time_point deadline) noexcept
+		{
+			push(waiter);
+
+			assert(waiter.fiber && "Coroutines can't wait with a deadline");
+
+			// Armed while holding the lock, so no notifier can try to disarm it before it exists
+			waiter.timed = true;
+			waiter.timer.deadline = deadline;
+			waiter.fiber->get_fiber_pool()->add_timer({}, waiter.timer);
+		}
+
+		bool wait_queue::notify_one() noexcept
+		{
+			// Skip waiters that already timed out, they will notice they are no longer queued
+			while (waiter* front = _head)
+			{
+				erase(*front);
+				if (wake(*front))
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		std::size_t wait_queue::notify_all() noexcept
+		{
+			std::size_t woken = 0;
+			while (waiter* front = _head)
+			{
+				erase(*front);
+				woken += wake(*front);
+			}
+
+			return woken;
+		}
+
+		bool wait_queue::notify(waiter& waiter) noexcept
+		{
+			erase(waiter);
+			return wake(waiter);
+		}
+
+		bool wait_queue::block(waiter& waiter) noexcept
+		{
+			waiter.fiber->get_fiber_pool()->block({});
+
+			if (waiter.status.load(std::memory_order_acquire) == wait_status::notified)
+			{
+				return true;
+			}
+
+			// Whoever popped us failed its claim while holding the lock, past it nobody references us
+			lock();
+			if (waiter.queued)
+			{
+				erase(waiter);
+			}
+			unlock();
+
+			return false;
+		}
+
+		void wait_queue::erase(waiter& waiter) noexcept
+		{
+			assert(waiter.queued && "Waiter is not queued");
+
+			if (waiter.previous)
+			{
+				waiter.previous->next = waiter.next;
+			}
+			else
+			{
+				_head = waiter.next;
+			}
+
+			if (waiter.next)
+			{
+				waiter.next->previous = waiter.previous;
+			}
+			else
+			{
+				_tail = waiter.previous;
+			}
+
+			waiter.queued = false;
+			waiter.previous = nullptr;
+			waiter.next = nullptr;
+		}
+
+		bool wait_queue::wake(waiter& waiter) noexcept
+		{
+			wait_status expected = wait_status::waiting;
+			if (!waiter.status.compare_exchange_strong(expected, wait_status::notified, std::memory_order_acq_rel))
+			{
+				return false;
+			}
+
+			// The coroutine may be resumed and its frame gone as soon as it is handed over, don't touch the waiter after
+			if (!waiter.fiber)
+			{
+				waiter.fiber_pool->resume({}, waiter.coroutine);
+				return true;
+			}
+
+			// The timer can no longer fire, but it might still be in the heap
+			auto fiber_pool = waiter.fiber->get_fiber_pool();
+			if (waiter.timed)
+			{
+				fiber_pool->remove_timer({}, waiter.timer);
+			}
+
+			fiber_pool->unblock({}, waiter.fiber);
+			return true;
+		}
+	}
+}
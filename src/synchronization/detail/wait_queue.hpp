@@ -0,0 +1,121 @@
+#pragma once
+
+#include "pool/timer_queue.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+
+
+namespace np
+{
+	class fiber_base;
+	class fiber_pool_base;
+
+	namespace detail
+	{
+		// A fiber parked in a wait_queue, it lives on the stack of that same fiber
+		//	Suspended coroutines park too, from their awaiter inside the coroutine frame, and are resumed by
+		//	their pool once woken. They can't be timed
+		struct waiter
+		{
+			waiter(np::fiber_base* fiber) noexcept;
+			waiter(std::coroutine_handle<> coroutine, np::fiber_pool_base* fiber_pool) noexcept;
+
+			np::fiber_base* fiber;
+			std::coroutine_handle<> coroutine;
+			np::fiber_pool_base* fiber_pool;
+			std::atomic<wait_status> status;
+			np::detail::timer timer;
+			bool timed;
+
+			bool queued;
+			waiter* previous;
+			waiter* next;
+		};
+
+		// Intrusive FIFO of parked fibers guarded by a small spinlock
+		//	Notifiers claim waiters while holding the lock and timers claim them under the pool's timer lock,
+		//	so a waiter that timed out only needs the lock to be sure nobody else will touch it
+		class wait_queue
+		{
+		public:
+			using clock = std::chrono::steady_clock;
+
+			wait_queue() noexcept;
+
+			wait_queue(const wait_queue&) = delete;
+			wait_queue& operator=(const wait_queue&) = delete;
+
+			inline void lock() noexcept;
+			inline void unlock() noexcept;
+
+			// Whether anyone holds the lock, seen after whatever they wrote under it before taking it
+			//	Lets waiters check that a notifier is done with the queue without locking it
+			inline bool locked() const noexcept;
+
+			// All of the following require the lock
+			inline bool empty() const noexcept;
+			inline waiter* front() const noexcept;
+			void push(waiter& waiter) noexcept;
+			void push(waiter& waiter, clock::time_point deadline) noexcept;
+			bool notify_one() noexcept;
+			std::size_t notify_all() noexcept;
+
+			// Unlinks a queued waiter and wakes it, false if it had already timed out
+			bool notify(waiter& waiter) noexcept;
+
+			// Blocks a pushed waiter, the lock must have been released, and returns false if it timed out
+			bool block(waiter& waiter) noexcept;
+
+		private:
+			void erase(waiter& waiter) noexcept;
+			bool wake(waiter& waiter) noexcept;
+
+		private:
+			std::atomic<bool> _lock;
+			waiter* _head;
+			waiter* _tail;
+		};
+
+
+		inline void wait_queue::lock() noexcept
+		{
+			while (_lock.exchange(true, std::memory_order_acquire))
+			{
+				while (_lock.load(std::memory_order_relaxed))
+				{
+#if defined(NETPUNK_SPINLOCK_PAUSE)
+#if defined(_MSC_VER)
+					_mm_pause();
+#else
+					__builtin_ia32_pause();
+#endif
+#endif // NETPUNK_SPINLOCK_PAUSE
+				}
+			}
+		}
+
+		inline void wait_queue::unlock() noexcept
+		{
+			assert(_lock.load(std::memory_order_relaxed) && "Can't unlock a non-locked wait queue");
+			_lock.store(false, std::memory_order_release);
+		}
+
+		inline bool wait_queue::locked() const noexcept
+		{
+			return _lock.load(std::memory_order_acquire);
+		}
+
+		inline bool wait_queue::empty() const noexcept
+		{
+			return _head == nullptr;
+		}
+
+		inline waiter* wait_queue::front() const noexcept
+		{
+			return _head;
+		}
+	}
+}
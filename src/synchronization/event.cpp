@@ -1,16 +1,23 @@
 #include "synchronization/event.hpp"
 #include "pool/fiber_pool.hpp"
 
+#include <utility>
+
 
 namespace np
 {
+	event::event() noexcept :
+		_awaiter(nullptr)
+	{}
+
 	void event::notify() noexcept
 	{
 		assert(this_fiber::fiber_pool() != nullptr && "Conditions variable require a fiber pool");
 
-		if (_awaiter)
+		// Waiters are only woken once, later notifications must not unblock a running fiber
+		if (np::fiber_base* awaiter = std::exchange(_awaiter, nullptr))
 		{
-			this_fiber::fiber_pool()->unblock({}, _awaiter);
+			this_fiber::fiber_pool()->unblock({}, awaiter);
 		}
 	}
 
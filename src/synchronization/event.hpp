@@ -9,10 +9,11 @@ namespace np
 	class fiber_pool_base;
 	class mutex;
 
+	// Wakes a single waiter, which must hold the mutex passed to wait, as must the notifier
 	class event
 	{
 	public:
-		event() noexcept = default;
+		event() noexcept;
 
 		void notify() noexcept;
 		void wait(np::mutex& mutex) noexcept;
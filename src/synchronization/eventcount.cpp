@@ -0,0 +1,93 @@
+#include "synchronization/eventcount.hpp"
+
+
+namespace np
+{
+	eventcount::eventcount() noexcept :
+		_state(0),
+		_mutex(),
+		_cv()
+	{}
+
+	uint32_t eventcount::prepare_wait() noexcept
+	{
+		// Registering and reading the epoch must be a single operation, otherwise a notification could
+		//	land in between and be lost
+		uint64_t previous = _state.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return uint32_t(previous >> 32);
+	}
+
+	void eventcount::cancel_wait() noexcept
+	{
+		_state.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void eventcount::wait(uint32_t key) noexcept
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (uint32_t(_state.load(std::memory_order_acquire) >> 32) == key)
+			{
+				_cv.wait(lock);
+			}
+		}
+
+		_state.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	bool eventcount::wait_until(uint32_t key, std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		bool notified = true;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (uint32_t(_state.load(std::memory_order_acquire) >> 32) == key)
+			{
+				if (_cv.wait_until(lock, deadline) == std::cv_status::timeout)
+				{
+					notified = uint32_t(_state.load(std::memory_order_acquire) >> 32) != key;
+					break;
+				}
+			}
+		}
+
+		_state.fetch_sub(1, std::memory_order_seq_cst);
+		return notified;
+	}
+
+	void eventcount::notify_one() noexcept
+	{
+		notify(false);
+	}
+
+	void eventcount::notify_all() noexcept
+	{
+		notify(true);
+	}
+
+	void eventcount::notify(bool all) noexcept
+	{
+		// Pairs with the fence in prepare_wait, either the waiter sees whatever we published before
+		//	notifying or we see the waiter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if ((_state.load(std::memory_order_relaxed) & waiters_mask) == 0)
+		{
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_state.fetch_add(epoch_increment, std::memory_order_seq_cst);
+		}
+
+		if (all)
+		{
+			_cv.notify_all();
+		}
+		else
+		{
+			_cv.notify_one();
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+
+namespace np
+{
+	// Lets threads sleep until some condition, checked outside of it, might have changed
+	//	Waiters call prepare_wait, re-check their condition and then either cancel_wait or wait
+	//	Notifiers only touch the mutex when someone is actually waiting
+	class eventcount
+	{
+	public:
+		eventcount() noexcept;
+
+		uint32_t prepare_wait() noexcept;
+		void cancel_wait() noexcept;
+		void wait(uint32_t key) noexcept;
+
+		// False if the deadline passed without a notification
+		bool wait_until(uint32_t key, std::chrono::steady_clock::time_point deadline) noexcept;
+
+		void notify_one() noexcept;
+		void notify_all() noexcept;
+
+	private:
+		void notify(bool all) noexcept;
+
+	private:
+		static constexpr uint64_t waiters_mask = 0xFFFFFFFF;
+		static constexpr uint64_t epoch_increment = uint64_t(1) << 32;
+
+		// Epoch in the high half, number of waiters in the low half
+		std::atomic<uint64_t> _state;
+		std::mutex _mutex;
+		std::condition_variable _cv;
+	};
+}
@@ -4,64 +4,46 @@
 
 #include <palanteer.h>
 
+#include <algorithm>
+
 
 namespace np
 {
     mutex::mutex() noexcept :
-        _status(status::unlocked)
+        mutex(mutex_mode::barging)
+    {}
+
+    mutex::mutex(mutex_mode mode) noexcept :
+        _status(status::unlocked),
+        _mode(mode),
+        _spin_estimate(0),
+        _waiters()
     {}
 
-    mutex::mutex(mutex&& other) noexcept
+    mutex::mutex(mutex&& other) noexcept :
+        _status(status(other._status)),
+        _mode(other._mode),
+        _spin_estimate(int32_t(other._spin_estimate)),
+        _waiters()
     {
-        other.lock();
-        _status = status(other._status);
-        _waiting_fibers = std::move(other._waiting_fibers);
-        other.unlock();
+        assert(other._waiters.empty() && "Can't move a mutex with waiting fibers");
     }
 
     mutex& mutex::operator=(mutex&& other) noexcept
     {
-        other.lock();
+        assert(_waiters.empty() && other._waiters.empty() && "Can't move a mutex with waiting fibers");
         _status = status(other._status);
-        _waiting_fibers = std::move(other._waiting_fibers);
-        other.unlock();
+        _mode = other._mode;
+        _spin_estimate = int32_t(other._spin_estimate);
 
-		return *this;
+        return *this;
     }
 
     void mutex::lock() noexcept
     {
-        for (;;)
+        if (!try_lock() && !spin())
         {
-            status expect = status::locked;
-            if (!_status.compare_exchange_strong(expect, status::adding_to_waitlist))
-            {
-                if (expect == status::unlocked)
-                {
-                    if (_status.compare_exchange_strong(expect, status::locked))
-                    {
-                        return;
-                    }
-                }
-
-#if defined(NETPUNK_SPINLOCK_PAUSE)
-#if defined(_MSC_VER)
-                _mm_pause();
-#else
-                __builtin_ia32_pause();
-#endif
-#endif // NETPUNK_SPINLOCK_PAUSE
-
-                continue;
-            }
-
-            auto fiber = this_fiber::instance();
-            assert(fiber && fiber->get_fiber_pool() != nullptr && "Fiber that block in mutexes must come from fiber pools");
-
-            _waiting_fibers.enqueue(fiber);
-            //_status.store(status::locked, std::memory_order_release);
-            _status.store(status::locked);
-            fiber->get_fiber_pool()->block({});
+            lock_slow(nullptr);
         }
     }
 
@@ -69,16 +51,47 @@ namespace np
     {
         // First do a relaxed load to check if lock is free in order to prevent
         // unnecessary cache misses if someone does while(!try_lock())
+        status expected = status::unlocked;
         return _status.load(std::memory_order_relaxed) == status::unlocked &&
-            _status.exchange(status::locked, std::memory_order_acquire) == status::unlocked;
+            _status.compare_exchange_strong(expected, status::locked, std::memory_order_acquire);
     }
 
-    void mutex::unlock() noexcept
+    bool mutex::try_lock_until(std::chrono::steady_clock::time_point deadline) noexcept
+    {
+        return try_lock() || spin() || lock_slow(&deadline);
+    }
+
+    bool mutex::spin() noexcept
     {
-        status expect_locked = status::locked;
-        while (!_status.compare_exchange_strong(expect_locked, status::unlocking))
+        // Owners can only release it meanwhile if they run on another worker
+        auto fiber = this_fiber::instance();
+        if (!fiber || fiber->get_fiber_pool()->number_of_threads() <= 1)
         {
-            expect_locked = status::locked;
+            return false;
+        }
+
+        // Adapts like glibc's adaptive mutexes, spinning up to twice what recent acquisitions needed
+        const int32_t estimate = _spin_estimate.load(std::memory_order_relaxed);
+        const int32_t limit = std::min(maximum_spin_iterations, estimate * 2 + 10);
+
+        int32_t spins = 0;
+        bool acquired = false;
+        while (spins < limit)
+        {
+            ++spins;
+
+            // Fair mutexes are never released while fibers are queued, they are handed over
+            status current = _status.load(std::memory_order_relaxed);
+            if (current == status::contended && _mode == mutex_mode::fair)
+            {
+                break;
+            }
+
+            if (current == status::unlocked && try_lock())
+            {
+                acquired = true;
+                break;
+            }
 
 #if defined(NETPUNK_SPINLOCK_PAUSE)
 #if defined(_MSC_VER)
@@ -89,15 +102,142 @@ namespace np
 #endif // NETPUNK_SPINLOCK_PAUSE
         }
 
-        // Unblock all waiting fibers
-        np::fiber_base* fiber;
-        while (_waiting_fibers.try_dequeue(fiber))
+        _spin_estimate.store(estimate + (spins - estimate) / 8, std::memory_order_relaxed);
+        return acquired;
+    }
+
+    bool mutex::lock_slow(const std::chrono::steady_clock::time_point* deadline) noexcept
+    {
+        auto fiber = this_fiber::instance();
+        assert(fiber && fiber->get_fiber_pool() != nullptr && "Fiber that block in mutexes must come from fiber pools");
+
+        for (;;)
         {
-            assert(fiber && fiber->get_fiber_pool() != nullptr && "Mutexes with waiting fibers require a fiber pool");
-            fiber->get_fiber_pool()->unblock({}, fiber);
+            detail::waiter waiter(fiber);
+
+            // Marking it contended under the queue lock means unlock will always find us queued
+            _waiters.lock();
+            if (_status.exchange(status::contended, std::memory_order_acquire) == status::unlocked)
+            {
+                _waiters.unlock();
+                return true;
+            }
+
+            if (!deadline)
+            {
+                _waiters.push(waiter);
+            }
+            else if (std::chrono::steady_clock::now() < *deadline)
+            {
+                _waiters.push(waiter, *deadline);
+            }
+            else
+            {
+                _waiters.unlock();
+                return false;
+            }
+
+            _waiters.unlock();
+
+            if (!_waiters.block(waiter))
+            {
+                return false;
+            }
+
+            // Being notified by a fair mutex means it is already ours
+            if (_mode == mutex_mode::fair)
+            {
+                return true;
+            }
+        }
+    }
+
+    void mutex::unlock() noexcept
+    {
+        assert(_status.load(std::memory_order_relaxed) != status::unlocked && "Can't unlock a non-locked mutex");
+
+        if (_mode == mutex_mode::barging)
+        {
+            if (_status.exchange(status::unlocked, std::memory_order_release) == status::locked)
+            {
+                return;
+            }
+
+            // The woken fiber races for the lock again, and marks it contended if it loses
+            //  Tasks can't go back to waiting once resumed, so they are handed the mutex instead, if nobody barged in
+            //  Anyone who did finds it contended, and comes back here when unlocking
+            _waiters.lock();
+            while (detail::waiter* front = _waiters.front())
+            {
+                if (!front->fiber)
+                {
+                    if (_status.exchange(status::contended, std::memory_order_acquire) == status::unlocked)
+                    {
+                        _waiters.notify(*front);
+                    }
+
+                    break;
+                }
+
+                // Fibers that timed out are skipped, as notify_one does
+                if (_waiters.notify(*front))
+                {
+                    break;
+                }
+            }
+            _waiters.unlock();
+            return;
+        }
+
+        status expected = status::locked;
+        if (!_status.compare_exchange_strong(expected, status::unlocked, std::memory_order_release, std::memory_order_relaxed))
+        {
+            unlock_slow();
+        }
+    }
+
+    mutex::lock_awaiter::lock_awaiter(mutex& mutex) noexcept :
+        _mutex(mutex),
+        _waiter(std::coroutine_handle<>{}, nullptr)
+    {}
+
+    bool mutex::lock_awaiter::await_ready() noexcept
+    {
+        return _mutex.try_lock();
+    }
+
+    bool mutex::lock_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+    {
+        _waiter.coroutine = coroutine;
+        _waiter.fiber_pool = fiber_pool_base::running_pool();
+        assert(_waiter.fiber_pool && "Tasks can only lock mutexes while run by a fiber pool");
+
+        // As in lock_slow, but unlockers hand it over to us, so there is no retrying once resumed
+        _mutex._waiters.lock();
+        if (_mutex._status.exchange(status::contended, std::memory_order_acquire) == status::unlocked)
+        {
+            _mutex._waiters.unlock();
+            return false;
         }
 
-        // Unlock now
-        _status.store(status::unlocked, std::memory_order_release);
+        _mutex._waiters.push(_waiter);
+        _mutex._waiters.unlock();
+        return true;
+    }
+
+    void mutex::unlock_slow() noexcept
+    {
+        // Contended fair mutexes never look unlocked, ownership goes straight to the oldest waiter
+        //  Lockers only change the status under the queue lock, and the new owner can't unlock before we release it
+        _waiters.lock();
+        if (!_waiters.notify_one())
+        {
+            _status.store(status::unlocked, std::memory_order_release);
+        }
+        else if (_waiters.empty())
+        {
+            _status.store(status::locked, std::memory_order_relaxed);
+        }
+        _waiters.unlock();
     }
 }
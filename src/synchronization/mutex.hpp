@@ -1,11 +1,12 @@
 #pragma once
 
+#include "synchronization/detail/wait_queue.hpp"
 #include "utils/badge.hpp"
 
 #include <atomic>
 #include <chrono>
-
-#include <concurrentqueue.h>
+#include <coroutine>
+#include <cstdint>
 
 
 namespace np
@@ -17,18 +18,42 @@ namespace np
 
 namespace np
 {
+    // Barging lets whoever comes first take a released mutex, even if others are already queued, which
+    //  keeps throughput high. Fair mutexes hand ownership straight to the oldest waiter instead
+    enum class mutex_mode : uint8_t
+    {
+        barging,
+        fair
+    };
+
     class mutex
     {
         enum class status
         {
             unlocked,
-            unlocking,
             locked,
-            adding_to_waitlist
+            contended
+        };
+
+    public:
+        // Suspends a task instead of blocking its worker, it owns the mutex once resumed
+        class lock_awaiter
+        {
+        public:
+            explicit lock_awaiter(mutex& mutex) noexcept;
+
+            bool await_ready() noexcept;
+            bool await_suspend(std::coroutine_handle<> coroutine) noexcept;
+            void await_resume() noexcept {}
+
+        private:
+            mutex& _mutex;
+            detail::waiter _waiter;
         };
 
     public:
         mutex() noexcept;
+        explicit mutex(mutex_mode mode) noexcept;
 
         mutex(mutex&& other) noexcept;
         mutex& operator=(mutex&& other) noexcept;
@@ -37,8 +62,44 @@ namespace np
         bool try_lock() noexcept;
         void unlock() noexcept;
 
+        template <typename rep, typename period>
+        bool try_lock_for(const std::chrono::duration<rep, period>& duration) noexcept;
+        bool try_lock_until(std::chrono::steady_clock::time_point deadline) noexcept;
+
+        // Only from tasks, as in co_await mutex.lock_async(), unlocking is the same for everyone
+        inline lock_awaiter lock_async() noexcept;
+
+        inline mutex_mode mode() const noexcept;
+
+    private:
+        bool spin() noexcept;
+        bool lock_slow(const std::chrono::steady_clock::time_point* deadline) noexcept;
+        void unlock_slow() noexcept;
+
     private:
+        // Upper bound for the adaptive spin, past it waiters park
+        static constexpr int32_t maximum_spin_iterations = 256;
+
         std::atomic<status> _status;
-        moodycamel::ConcurrentQueue<np::fiber_base*> _waiting_fibers;
+        mutex_mode _mode;
+        std::atomic<int32_t> _spin_estimate;
+        detail::wait_queue _waiters;
     };
+
+
+    template <typename rep, typename period>
+    bool mutex::try_lock_for(const std::chrono::duration<rep, period>& duration) noexcept
+    {
+        return try_lock_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+    }
+
+    inline mutex::lock_awaiter mutex::lock_async() noexcept
+    {
+        return lock_awaiter{ *this };
+    }
+
+    inline mutex_mode mutex::mode() const noexcept
+    {
+        return _mode;
+    }
 }
@@ -6,36 +6,115 @@ namespace np
 {
 	one_way_barrier::one_way_barrier(std::size_t size) noexcept :
 		_size(size),
-		_fiber(nullptr)
+		_waiters()
 	{}
 
 	void one_way_barrier::reset(std::size_t size) noexcept
 	{
+		assert(_waiters.empty() && "Can't reset a one_way_barrier with waiting fibers");
 		_size = size;
-		_fiber = nullptr;
 	}
 
 	void one_way_barrier::decrease() noexcept
 	{
-		if (--_size == 0)
+		// Only the last one takes the lock
+		std::size_t size = _size.load(std::memory_order_relaxed);
+		while (size > 1)
 		{
-			auto fiber = this_fiber::instance(); 
-			np::fiber_base* waiter;
-			while (!(waiter = _fiber.load(std::memory_order_relaxed)))
+			if (_size.compare_exchange_weak(size, size - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
 			{
-				fiber->get_fiber_pool()->yield();
+				return;
 			}
+		}
 
-			waiter->get_fiber_pool()->unblock({}, waiter);
+		// Reaching zero under the lock, waiters that see it there know we are done with the barrier
+		_waiters.lock();
+		if (--_size == 0)
+		{
+			_waiters.notify_all();
 		}
+		_waiters.unlock();
 	}
 
 	void one_way_barrier::wait() noexcept
 	{
-		assert(_fiber.load(std::memory_order_relaxed) == nullptr && "Only one fiber can wait on a one_way_barrier");
+		wait_impl(nullptr);
+	}
+
+	bool one_way_barrier::wait_until(std::chrono::steady_clock::time_point deadline) noexcept
+	{
+		return wait_impl(&deadline);
+	}
 
-		auto fiber = this_fiber::instance();
-		_fiber.store(fiber, std::memory_order_release);
-		fiber->get_fiber_pool()->block({});
+	bool one_way_barrier::wait_impl(const std::chrono::steady_clock::time_point* deadline) noexcept
+	{
+		_waiters.lock();
+		if (_size == 0)
+		{
+			_waiters.unlock();
+			return true;
+		}
+
+		detail::waiter waiter(this_fiber::instance());
+		if (deadline)
+		{
+			_waiters.push(waiter, *deadline);
+		}
+		else
+		{
+			_waiters.push(waiter);
+		}
+
+		_waiters.unlock();
+		if (!_waiters.block(waiter))
+		{
+			return false;
+		}
+
+		// Woken while the last decrease still holds the lock, wait until it lets go before the barrier can go away
+		_waiters.lock();
+		_waiters.unlock();
+		return true;
+	}
+
+	one_way_barrier::wait_awaiter::wait_awaiter(one_way_barrier& barrier) noexcept :
+		_barrier(barrier),
+		_waiter(std::coroutine_handle<>{}, nullptr),
+		_parked(false)
+	{}
+
+	bool one_way_barrier::wait_awaiter::await_ready() noexcept
+	{
+		// A held lock may be the last decrease still notifying
+		return _barrier._size.load(std::memory_order_acquire) == 0 && !_barrier._waiters.locked();
+	}
+
+	bool one_way_barrier::wait_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+	{
+		_waiter.coroutine = coroutine;
+		_waiter.fiber_pool = fiber_pool_base::running_pool();
+		assert(_waiter.fiber_pool && "Tasks can only wait while run by a fiber pool");
+
+		_barrier._waiters.lock();
+		if (_barrier._size == 0)
+		{
+			_barrier._waiters.unlock();
+			return false;
+		}
+
+		_parked = true;
+		_barrier._waiters.push(_waiter);
+		_barrier._waiters.unlock();
+		return true;
+	}
+
+	void one_way_barrier::wait_awaiter::await_resume() noexcept
+	{
+		// Resumed while the last decrease still holds the lock, as in wait
+		if (_parked)
+		{
+			_barrier._waiters.lock();
+			_barrier._waiters.unlock();
+		}
 	}
 }
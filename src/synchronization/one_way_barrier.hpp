@@ -1,6 +1,10 @@
 #pragma once
 
+#include "synchronization/detail/wait_queue.hpp"
+
 #include <atomic>
+#include <chrono>
+#include <coroutine>
 
 
 namespace np
@@ -9,6 +13,23 @@ namespace np
 
 	class one_way_barrier
 	{
+	public:
+		// Suspends a task instead of blocking its worker, it is resumed once the barrier reaches zero
+		class wait_awaiter
+		{
+		public:
+			explicit wait_awaiter(one_way_barrier& barrier) noexcept;
+
+			bool await_ready() noexcept;
+			bool await_suspend(std::coroutine_handle<> coroutine) noexcept;
+			void await_resume() noexcept;
+
+		private:
+			one_way_barrier& _barrier;
+			detail::waiter _waiter;
+			bool _parked;
+		};
+
 	public:
 		one_way_barrier(std::size_t size) noexcept;
 
@@ -16,8 +37,32 @@ namespace np
 		void decrease() noexcept;
 		void wait() noexcept;
 
+		// False if the deadline passed before the barrier reached zero
+		bool wait_until(std::chrono::steady_clock::time_point deadline) noexcept;
+
+		template <typename rep, typename period>
+		bool wait_for(const std::chrono::duration<rep, period>& duration) noexcept;
+
+		// Only from tasks, as in co_await barrier.wait_async()
+		inline wait_awaiter wait_async() noexcept;
+
+	private:
+		bool wait_impl(const std::chrono::steady_clock::time_point* deadline) noexcept;
+
 	private:
 		std::atomic<std::size_t> _size;
-		std::atomic<np::fiber_base*> _fiber;
+		detail::wait_queue _waiters;
 	};
+
+
+	inline one_way_barrier::wait_awaiter one_way_barrier::wait_async() noexcept
+	{
+		return wait_awaiter{ *this };
+	}
+
+	template <typename rep, typename period>
+	bool one_way_barrier::wait_for(const std::chrono::duration<rep, period>& duration) noexcept
+	{
+		return wait_until(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+	}
 }
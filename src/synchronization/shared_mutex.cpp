@@ -0,0 +1,204 @@
+#include "synchronization/shared_mutex.hpp"
+#include "pool/fiber_pool.hpp"
+
+
+namespace np
+{
+	shared_mutex::shared_mutex() noexcept :
+		_slots(),
+		_writers(0),
+		_writer_lock(),
+		_readers_waiters(),
+		_writer_waiter()
+	{}
+
+	void shared_mutex::lock() noexcept
+	{
+		// Announcing ourselves first keeps new readers away while we queue behind other writers
+		_writers.fetch_add(1, std::memory_order_seq_cst);
+		_writer_lock.lock();
+		wait_for_readers();
+	}
+
+	bool shared_mutex::try_lock() noexcept
+	{
+		if (_writers.load(std::memory_order_relaxed) != 0)
+		{
+			return false;
+		}
+
+		_writers.fetch_add(1, std::memory_order_seq_cst);
+		if (!_writer_lock.try_lock())
+		{
+			release_writer();
+			return false;
+		}
+
+		if (readers() != 0)
+		{
+			_writer_lock.unlock();
+			release_writer();
+			return false;
+		}
+
+		return true;
+	}
+
+	void shared_mutex::unlock() noexcept
+	{
+		_writer_lock.unlock();
+		release_writer();
+	}
+
+	np::task<> shared_mutex::lock_async() noexcept
+	{
+		// As in lock, a single time without readers is enough, those coming later see us and back off
+		_writers.fetch_add(1, std::memory_order_seq_cst);
+		co_await _writer_lock.lock_async();
+		while (readers() != 0)
+		{
+			co_await park_awaiter{ *this, true };
+		}
+	}
+
+	np::task<> shared_mutex::lock_shared_async() noexcept
+	{
+		while (!try_lock_shared())
+		{
+			co_await park_awaiter{ *this, false };
+		}
+	}
+
+	shared_mutex::park_awaiter::park_awaiter(shared_mutex& mutex, bool writer) noexcept :
+		_mutex(mutex),
+		_writer(writer),
+		_waiter(std::coroutine_handle<>{}, nullptr)
+	{}
+
+	bool shared_mutex::park_awaiter::await_suspend(std::coroutine_handle<> coroutine) noexcept
+	{
+		_waiter.coroutine = coroutine;
+		_waiter.fiber_pool = fiber_pool_base::running_pool();
+		assert(_waiter.fiber_pool && "Tasks can only lock shared mutexes while run by a fiber pool");
+
+		// Checked under the queue lock as fibers do, once pushed we may be resumed elsewhere, don't touch this after unlocking
+		detail::wait_queue& queue = _writer ? _mutex._writer_waiter : _mutex._readers_waiters;
+		queue.lock();
+		if (_writer ? _mutex.readers() == 0 : _mutex._writers.load(std::memory_order_seq_cst) == 0)
+		{
+			queue.unlock();
+			return false;
+		}
+
+		queue.push(_waiter);
+		queue.unlock();
+		return true;
+	}
+
+	void shared_mutex::lock_shared() noexcept
+	{
+		for (;;)
+		{
+			if (try_lock_shared())
+			{
+				return;
+			}
+
+			auto fiber = this_fiber::instance();
+			assert(fiber && fiber->get_fiber_pool() != nullptr && "Fiber that block in shared mutexes must come from fiber pools");
+
+			// The last writer out checks for readers under this same lock
+			detail::waiter waiter(fiber);
+			_readers_waiters.lock();
+			if (_writers.load(std::memory_order_seq_cst) == 0)
+			{
+				_readers_waiters.unlock();
+				continue;
+			}
+
+			_readers_waiters.push(waiter);
+			_readers_waiters.unlock();
+			_readers_waiters.block(waiter);
+		}
+	}
+
+	bool shared_mutex::try_lock_shared() noexcept
+	{
+		// Pairs with writers announcing themselves and then counting readers, one of both sees the other
+		auto& slot = this_slot();
+		slot.fetch_add(1, std::memory_order_seq_cst);
+		if (_writers.load(std::memory_order_seq_cst) == 0)
+		{
+			return true;
+		}
+
+		// The writer might have counted us already
+		slot.fetch_sub(1, std::memory_order_seq_cst);
+		notify_writer();
+		return false;
+	}
+
+	void shared_mutex::unlock_shared() noexcept
+	{
+		this_slot().fetch_sub(1, std::memory_order_seq_cst);
+		if (_writers.load(std::memory_order_seq_cst) != 0)
+		{
+			notify_writer();
+		}
+	}
+
+	std::atomic<int32_t>& shared_mutex::this_slot() noexcept
+	{
+		return _slots[fiber_pool_base::thread_index() % reader_slots].readers;
+	}
+
+	int32_t shared_mutex::readers() const noexcept
+	{
+		int32_t total = 0;
+		for (const auto& slot : _slots)
+		{
+			total += slot.readers.load(std::memory_order_seq_cst);
+		}
+
+		return total;
+	}
+
+	void shared_mutex::wait_for_readers() noexcept
+	{
+		auto fiber = this_fiber::instance();
+		assert(fiber && fiber->get_fiber_pool() != nullptr && "Fiber that block in shared mutexes must come from fiber pools");
+
+		// Readers leaving decrement before taking the lock, so counting under it can't miss their wake up
+		for (;;)
+		{
+			detail::waiter waiter(fiber);
+			_writer_waiter.lock();
+			if (readers() == 0)
+			{
+				_writer_waiter.unlock();
+				return;
+			}
+
+			_writer_waiter.push(waiter);
+			_writer_waiter.unlock();
+			_writer_waiter.block(waiter);
+		}
+	}
+
+	void shared_mutex::notify_writer() noexcept
+	{
+		_writer_waiter.lock();
+		_writer_waiter.notify_one();
+		_writer_waiter.unlock();
+	}
+
+	void shared_mutex::release_writer() noexcept
+	{
+		if (_writers.fetch_sub(1, std::memory_order_seq_cst) == 1)
+		{
+			_readers_waiters.lock();
+			_readers_waiters.notify_all();
+			_readers_waiters.unlock();
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "coroutine/task.hpp"
+#include "synchronization/detail/wait_queue.hpp"
+#include "synchronization/mutex.hpp"
+#include "utils/cacheline.hpp"
+
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+
+
+namespace np
+{
+	class fiber_base;
+	class fiber_pool_base;
+
+	// Reader-writer lock for read-mostly data, readers and writers may be fibers or tasks
+	//	Readers count themselves on a slot of their worker, so they never share a cache line while
+	//	no writer is around. Writers go first, once one asks for the lock new readers wait for it
+	class shared_mutex
+	{
+	public:
+		shared_mutex() noexcept;
+
+		shared_mutex(const shared_mutex&) = delete;
+		shared_mutex& operator=(const shared_mutex&) = delete;
+
+		void lock() noexcept;
+		bool try_lock() noexcept;
+		void unlock() noexcept;
+
+		void lock_shared() noexcept;
+		bool try_lock_shared() noexcept;
+		void unlock_shared() noexcept;
+
+		// Only from tasks, as in co_await mutex.lock_async(), unlocking is the same for everyone
+		//	Either may have to park more than once, so they are tasks of their own
+		np::task<> lock_async() noexcept;
+		np::task<> lock_shared_async() noexcept;
+
+	private:
+		// Parks a task on the writer's or the readers' queue, unless what it waits for already happened
+		class park_awaiter
+		{
+		public:
+			park_awaiter(shared_mutex& mutex, bool writer) noexcept;
+
+			bool await_ready() noexcept { return false; }
+			bool await_suspend(std::coroutine_handle<> coroutine) noexcept;
+			void await_resume() noexcept {}
+
+		private:
+			shared_mutex& _mutex;
+			bool _writer;
+			detail::waiter _waiter;
+		};
+
+		static constexpr std::size_t reader_slots = 16;
+
+		struct alignas(detail::cacheline_length) reader_slot
+		{
+			// Fibers may unlock from another worker than the one they locked from, only the sum is meaningful
+			std::atomic<int32_t> readers;
+		};
+
+		std::atomic<int32_t>& this_slot() noexcept;
+		int32_t readers() const noexcept;
+		void wait_for_readers() noexcept;
+		void notify_writer() noexcept;
+		void release_writer() noexcept;
+
+	private:
+		std::array<reader_slot, reader_slots> _slots;
+
+		// Writers either holding or waiting for the lock
+		alignas(detail::cacheline_length) std::atomic<uint32_t> _writers;
+		np::mutex _writer_lock;
+		detail::wait_queue _readers_waiters;
+		detail::wait_queue _writer_waiter;
+	};
+}
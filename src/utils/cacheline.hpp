@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace np
+{
+    namespace detail
+    {
+        inline constexpr std::size_t cacheline_length = 64;
+    }
+}